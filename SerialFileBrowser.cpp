@@ -1,4 +1,5 @@
 #include "SerialFileBrowser.h"
+#include "xycrc.h"
 
 void SerialFileBrowser::setup_cli(void) {
   port->setTimeout(0);
@@ -14,6 +15,13 @@ void SerialFileBrowser::loop_cli(void) {
       port->print("$ ");
     }
   }
+  else if (ZmodemMode) {
+    if (rzmodem.loop() == 0) {
+      ZmodemMode = false;
+      port->println();
+      port->print("$ ");
+    }
+  }
   else {
     if (port->available() > 0) {
       int b = port->read();
@@ -38,7 +46,7 @@ void SerialFileBrowser::loop_cli(void) {
               aLine[bytesIn] = '\0';
               execute(aLine);
               bytesIn = 0;
-              if (!CaptureMode) port->print("$ ");
+              if (!CaptureMode && !XYmodemMode && !ZmodemMode) port->print("$ ");
               break;
             case '\b':  // backspace
               if (bytesIn > 0) {
@@ -58,7 +66,7 @@ void SerialFileBrowser::loop_cli(void) {
                 aLine[bytesIn] = '\0';
                 execute(aLine);
                 bytesIn = 0;
-                if (!CaptureMode && !XYmodemMode) port->print("$ ");
+                if (!CaptureMode && !XYmodemMode && !ZmodemMode) port->print("$ ");
               }
               break;
           }
@@ -70,36 +78,12 @@ void SerialFileBrowser::loop_cli(void) {
 
 int SerialFileBrowser::make_full_pathname(char *name, char *pathname, size_t pathname_len)
 {
-  if (name == NULL || name == '\0') return -1;
-  if (pathname == NULL || pathname_len == 0) return -1;
-
-  // if dir name starts with '/', it is a full pathname so make it.
-  // else form full pathname with current working directory.
-  if (*name == '/') {
-    strncpy(pathname, name, pathname_len);
-    pathname[pathname_len-1] = '\0';
-  }
-  else {
-    strcpy(pathname, cwd);
-    if (cwd[strlen(cwd)-1] == '/') {
-      if (strlen(cwd) + strlen(name) >= pathname_len) {
-        port->println("pathname too long");
-        return -2;
-      }
-    }
-    else {
-      if (strlen(cwd) + 1 + strlen(name) >= pathname_len) {
-        port->println("pathname too long");
-        return -2;
-      }
-      strcat(pathname, "/");
-    }
-    strcat(pathname, name);
-  }
-  return 0;
+  int err = xy_full_pathname(cwd, name, pathname, pathname_len);
+  if (err == -2) port->println("pathname too long");
+  return err;
 }
 
-void SerialFileBrowser::remove_file(char *aLine) {
+void SerialFileBrowser::remove_file(char * /*aLine*/) {
   char *filename = strtok(NULL, " \t");
   char pathname[128+1];
   if (make_full_pathname(filename, pathname, sizeof(pathname)) != 0) return;
@@ -111,7 +95,7 @@ void SerialFileBrowser::remove_file(char *aLine) {
   }
 }
 
-void SerialFileBrowser::change_dir(char *aLine) {
+void SerialFileBrowser::change_dir(char * /*aLine*/) {
   char *dirname = strtok(NULL, " \t");
   char pathname[128+1];
 
@@ -130,7 +114,7 @@ void SerialFileBrowser::change_dir(char *aLine) {
   d.close();
 }
 
-void SerialFileBrowser::make_dir(char *aLine) {
+void SerialFileBrowser::make_dir(char * /*aLine*/) {
   char *dirname = strtok(NULL, " \t");
   char pathname[128+1];
 
@@ -147,7 +131,7 @@ void SerialFileBrowser::make_dir(char *aLine) {
   }
 }
 
-void SerialFileBrowser::remove_dir(char *aLine) {
+void SerialFileBrowser::remove_dir(char * /*aLine*/) {
   // Delete a directory with the rmdir command.  Be careful as
   // this will delete EVERYTHING in the directory at all levels!
   // I.e. this is like running a recursive delete, rm -rf, in
@@ -167,7 +151,7 @@ void SerialFileBrowser::remove_dir(char *aLine) {
   }
 }
 
-void SerialFileBrowser::print_dir(char *aLine) {
+void SerialFileBrowser::print_dir(char * /*aLine*/) {
   File dir = fsptr->open(cwd);
   if (!dir) {
     port->println("Directory open failed");
@@ -195,7 +179,7 @@ void SerialFileBrowser::print_dir(char *aLine) {
   }
 }
 
-void SerialFileBrowser::print_file(char *aLine) {
+void SerialFileBrowser::print_file(char * /*aLine*/) {
   char *filename = strtok(NULL, " \t");
   char pathname[128+1];
 
@@ -221,7 +205,7 @@ void SerialFileBrowser::print_file(char *aLine) {
   readFile.close();
 }
 
-void SerialFileBrowser::capture_file(char *aLine) {
+void SerialFileBrowser::capture_file(char * /*aLine*/) {
   char *filename = strtok(NULL, " \t");
   char pathname[128+1];
 
@@ -234,22 +218,146 @@ void SerialFileBrowser::capture_file(char *aLine) {
   CaptureMode = true;
 }
 
-void SerialFileBrowser::print_working_dir(char *aLine) {
+void SerialFileBrowser::print_working_dir(char * /*aLine*/) {
   port->println(cwd);
 }
 
-void SerialFileBrowser::recv_xmodem(char *aLine) {
+void SerialFileBrowser::recv_xmodem(char * /*aLine*/) {
   char *filename = strtok(NULL, " \t");
 
+  rxymodem.setWindow(0);
   rxymodem.start_rx(*port, *fsptr, filename, true, true);
   XYmodemMode = true;
 }
 
-void SerialFileBrowser::recv_ymodem(char *aLine) {
-  rxymodem.start_rb(*port, *fsptr, true, true);
+void SerialFileBrowser::recv_ymodem(char * /*aLine*/) {
+  char *option;
+  bool streaming = false;
+  uint8_t window = 0;
+
+  while ((option = strtok(NULL, " \t")) != NULL) {
+    if (strcmp(option, "-g") == 0) {
+      streaming = true;
+    }
+    else if (strncmp(option, "-w", 2) == 0) {
+      window = atoi(option + 2);
+    }
+  }
+  rxymodem.setWindow(window);
+  rxymodem.start_rb(*port, *fsptr, true, true, streaming);
+  XYmodemMode = true;
+}
+
+void SerialFileBrowser::recv_zmodem(char * /*aLine*/) {
+  rzmodem.start_rz(*port, *fsptr);
+  ZmodemMode = true;
+}
+
+void SerialFileBrowser::send_xmodem(char * /*aLine*/) {
+  char *filename = strtok(NULL, " \t");
+  bool tx_1k = false;
+  char pathname[128+1];
+
+  if (filename != NULL && strcmp(filename, "-k") == 0) {
+    tx_1k = true;
+    filename = strtok(NULL, " \t");
+  }
+  if (make_full_pathname(filename, pathname, sizeof(pathname)) != 0) return;
+  rxymodem.setWindow(0);
+  if (rxymodem.start_sx(*port, *fsptr, pathname, tx_1k) != 0) {
+    port->println("Error, failed to open file for reading!");
+    return;
+  }
+  XYmodemMode = true;
+}
+
+void SerialFileBrowser::send_ymodem(char * /*aLine*/) {
+  char *filename;
+  uint8_t count = 0;
+  uint8_t window = 0;
+
+  // The names stay in aLine, which is not touched until the transfer ends.
+  while ((count < sizeof(tx_files)/sizeof(tx_files[0])) &&
+      ((filename = strtok(NULL, " \t")) != NULL)) {
+    if ((count == 0) && (strncmp(filename, "-w", 2) == 0)) {
+      window = atoi(filename + 2);
+      continue;
+    }
+    tx_files[count++] = filename;
+  }
+  if (count == 0) {
+    port->println("No files to send");
+    return;
+  }
+  rxymodem.setWindow(window);
+  if (rxymodem.start_sb(*port, *fsptr, cwd, tx_files, count, true) != 0) {
+    port->println("Error, send failed to start!");
+    return;
+  }
   XYmodemMode = true;
 }
 
+void SerialFileBrowser::dump_events(char * /*aLine*/) {
+  rxymodem.dumpEvents(*port);
+}
+
+// Print "<crc32> <sha256> <bytes> <name>". The SHA-256 is "-" if not known.
+void SerialFileBrowser::print_digest(uint32_t crc, const uint8_t *sha,
+    uint32_t bytes, const char *name) {
+  char line[24];
+
+  snprintf(line, sizeof(line), "%08lx ", (unsigned long)crc);
+  port->print(line);
+  if (sha != NULL) {
+    for (uint8_t i = 0; i < XYsha256::DIGEST_SIZE; i++) {
+      snprintf(line, sizeof(line), "%02x", sha[i]);
+      port->print(line);
+    }
+  }
+  else {
+    port->print('-');
+  }
+  snprintf(line, sizeof(line), " %lu ", (unsigned long)bytes);
+  port->print(line);
+  port->println(name);
+}
+
+// With a file name, read the file back and print its CRC-32 (zlib crc32)
+// and SHA-256. Without, print the digest of the last file received, taken
+// as it was written.
+void SerialFileBrowser::print_sum(char * /*aLine*/) {
+  char *filename = strtok(NULL, " \t");
+  char pathname[128+1];
+  uint8_t sha[XYsha256::DIGEST_SIZE];
+
+  if (filename == NULL) {
+    const XYmodem::stats_t &stats = rxymodem.getStats();
+    print_digest(stats.file_crc32, (rxymodem.fileSha256(sha)) ? sha : NULL,
+        stats.file_bytes, "(last received)");
+    return;
+  }
+  if (make_full_pathname(filename, pathname, sizeof(pathname)) != 0) return;
+  File readFile = fsptr->open(pathname, FILE_READ);
+  if (!readFile) {
+    port->println("Error, failed to open file for reading!");
+    return;
+  }
+  XYsha256 hash;
+  uint32_t crc = 0;
+  uint32_t bytes = 0;
+  while (readFile.available()) {
+    uint8_t buf[512];
+    int n = readFile.read(buf, sizeof(buf));
+    if (n <= 0) break;
+    crc = XYcrc32::update(crc, buf, n);
+    hash.update(buf, n);
+    bytes += n;
+  }
+  readFile.close();
+  hash.finish(sha);
+  print_digest(crc, sha, bytes, pathname);
+}
+
 // force lower case
 void SerialFileBrowser::toLower(char *s) {
   while (*s) {
@@ -260,7 +368,7 @@ void SerialFileBrowser::toLower(char *s) {
   }
 }
 
-void SerialFileBrowser::print_commands(char *aLine) {
+void SerialFileBrowser::print_commands(char * /*aLine*/) {
   port->print(commands[0].command);
   for (size_t i = 1; i < sizeof(commands)/sizeof(commands[0]); i++) {
     port->print(','); port->print(commands[i].command);
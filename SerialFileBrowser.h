@@ -2,6 +2,7 @@
 #define _SERIAL_FILE_BROWSER_H_
 
 #include "xymodem.h"
+#include "zmodem.h"
 
 // https://isocpp.org/wiki/faq/pointers-to-members
 #define CALL_MEMBER_FN(object,ptrToMember)  ((object)->*(ptrToMember))
@@ -15,7 +16,7 @@ class SerialFileBrowser {
     }
 
     SerialFileBrowser(Stream &port, FS &fs, Stream &debugport)
-    : rxymodem(&debugport) {
+    : rxymodem(&debugport), rzmodem(&debugport) {
       this->port = &port;
       fsptr = &fs;
       this->debugport = &debugport;
@@ -24,6 +25,17 @@ class SerialFileBrowser {
     void setup_cli(void);
     void loop_cli(void);
 
+    // SHA-256 context for the sum command to report the last file received.
+    // NULL = off. See XYmodem::setSha256().
+    void setSha256(XYsha256 *sha) {
+      rxymodem.setSha256(sha);
+    }
+    // Event trace buffer for the evdump command. NULL = off. See
+    // XYmodem::setEventTrace().
+    void setEventTrace(xyevent_t *buf, uint16_t count) {
+      rxymodem.setEventTrace(buf, count);
+    }
+
   private:
     typedef void (SerialFileBrowser::*action_func_t)(char *aLine);
 
@@ -32,7 +44,7 @@ class SerialFileBrowser {
       action_func_t action;
     } command_action_t;
 
-    command_action_t commands[15] = {
+    command_action_t commands[20] = {
       // Name of command user types, function that implements the command.
       {"dir", &SerialFileBrowser::print_dir},
       {"ls", &SerialFileBrowser::print_dir},
@@ -47,6 +59,11 @@ class SerialFileBrowser {
       {"capture", &SerialFileBrowser::capture_file},
       {"rx", &SerialFileBrowser::recv_xmodem},
       {"rb", &SerialFileBrowser::recv_ymodem},
+      {"rz", &SerialFileBrowser::recv_zmodem},
+      {"sx", &SerialFileBrowser::send_xmodem},
+      {"sb", &SerialFileBrowser::send_ymodem},
+      {"evdump", &SerialFileBrowser::dump_events},
+      {"sum", &SerialFileBrowser::print_sum},
       {"help", &SerialFileBrowser::print_commands},
       {"?", &SerialFileBrowser::print_commands},
     };
@@ -62,6 +79,13 @@ class SerialFileBrowser {
     void print_working_dir(char *aLine);
     void recv_xmodem(char *aLine);
     void recv_ymodem(char *aLine);
+    void recv_zmodem(char *aLine);
+    void send_xmodem(char *aLine);
+    void send_ymodem(char *aLine);
+    void dump_events(char *aLine);
+    void print_sum(char *aLine);
+    void print_digest(uint32_t crc, const uint8_t *sha, uint32_t bytes,
+        const char *name);
     void toLower(char *s);
     void print_commands(char *aLine);
     void execute(char *aLine);
@@ -71,12 +95,15 @@ class SerialFileBrowser {
     char cwd[128+1];     // Current Working Directory
     bool CaptureMode = false;
     bool XYmodemMode = false;
+    bool ZmodemMode = false;
     File CaptureFile;
+    const char *tx_files[16];   // sb file names, point into aLine
     FS *fsptr;
 
     Stream *port;
     Stream *debugport;
     XYmodem rxymodem;
+    Zmodem rzmodem;
 };
 
 #endif
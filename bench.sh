@@ -0,0 +1,148 @@
+#!/bin/bash
+# Throughput benchmark of the XMODEM/YMODEM and ZMODEM receivers using lrzsz
+# sb, sx and sz as the senders.
+#
+#    ./bench.sh > results.csv
+#    ./bench.sh /dev/ttyACM0 [baud] > results.csv
+#
+# With no tty the receiver is the host build, build/test/xyrecv (set XYRECV
+# to use another path), on a pty. It runs the same engine as the sketches
+# and reports its own CPU time. It sweeps YMODEM batch (sb against
+# start_rb), XMODEM (sx against start_rx) and ZMODEM (sz against
+# start_rz), CRC-16 and checksum, which the receiver picks (xyrecv -c),
+# 128 vs 1K blocks, file size, and for YMODEM and ZMODEM the batch size
+# (files per run). ZMODEM runs only once per file size and batch size,
+# shown as crc32 with 1K blocks, since sz picks its own subpacket length
+# and CRC.
+#
+# With a tty the receiver is a board running the rxymodem example, which
+# is fixed to YMODEM batch with CRC, so only block size, file size and
+# batch size are swept. Its CPU time is not visible from the host, so that
+# column is left empty.
+#
+# Set PROTOS, CHECKS, SIZES and BATCHES to narrow the sweep. Prints one
+# CSV line per run:
+#
+# proto,check,block,files,file_bytes,total_bytes,seconds,bytes_per_s,
+# blocks_per_s,setup_ms_per_file,rx_cpu_us_per_kb
+#
+# setup_ms_per_file comes from a batch of empty files so it is the block 0
+# and EOT handshake cost alone.
+TTY=${1:-}
+BAUD=${2:-115200}
+PROTOS=${PROTOS:-"ymodem xmodem zmodem"}
+CHECKS=${CHECKS:-"crc sum"}
+SIZES=${SIZES:-"1024 16384 131072 1048576"}
+BATCHES=${BATCHES:-"1 4"}
+XYRECV=${XYRECV:-./build/test/xyrecv}
+WORKDIR="/tmp/xybench_$$"
+
+if [ -n "${TTY}" ]; then
+    [ -c "${TTY}" ] || { echo "${TTY} not found" >&2; exit 1; }
+    stty -F ${TTY} ${BAUD} raw -echo -ixon -ixoff
+    PROTOS="ymodem"
+    CHECKS="crc"
+else
+    [ -x "${XYRECV}" ] || { echo "${XYRECV} not found, build the tests" >&2; exit 1; }
+fi
+for PROTO in ${PROTOS}; do
+    case ${PROTO} in
+        ymodem) SENDER=sb ;;
+        xmodem) SENDER=sx ;;
+        zmodem) SENDER=sz ;;
+        *) echo "unknown protocol ${PROTO}" >&2; exit 1 ;;
+    esac
+    which ${SENDER} >/dev/null || { echo "${SENDER} not found, install lrzsz" >&2; exit 1; }
+done
+mkdir -p ${WORKDIR}/rx
+trap "rm -rf ${WORKDIR}" EXIT
+
+# Run sb (ymodem), sx (xmodem) or sz (zmodem) with the given arguments
+# against the receiver. Prints "real rx_cpu_us", rx_cpu_us empty for a board.
+run_sender() {
+    local PROTO=$1
+    local CHECK=$2
+    shift 2
+    local TIMEFORMAT='%3R'
+    local SENDER=sb
+    local RXOPTS=""
+    local REAL
+    if [ ${PROTO} = "xmodem" ]; then
+        SENDER=sx
+        RXOPTS="-x /x.bin"
+    elif [ ${PROTO} = "zmodem" ]; then
+        SENDER=sz
+        RXOPTS="-z"
+    fi
+    if [ ${CHECK} = "sum" ]; then
+        RXOPTS="${RXOPTS} -c"
+    fi
+    if [ -n "${TTY}" ]; then
+        REAL=$( { time ${SENDER} -q "$@" <${TTY} >${TTY} 2>/dev/null ; } 2>&1 )
+        echo "${REAL}"
+        return
+    fi
+    rm -f ${WORKDIR}/rx/* ${WORKDIR}/rx.out
+    ${XYRECV} ${RXOPTS} ${WORKDIR}/rx > ${WORKDIR}/rx.out &
+    local PID=$!
+    local PTY=""
+    while [ -z "${PTY}" ] && kill -0 ${PID} 2>/dev/null; do
+        sleep 0.05
+        PTY=$(awk '/^pty /{print $2}' ${WORKDIR}/rx.out)
+    done
+    REAL=$( { time ${SENDER} -q "$@" <${PTY} >${PTY} 2>/dev/null ; } 2>&1 )
+    wait ${PID}
+    echo "${REAL} $(sed -n 's/.*cpu_us=\([0-9]*\).*/\1/p' ${WORKDIR}/rx.out)"
+}
+
+echo "proto,check,block,files,file_bytes,total_bytes,seconds,bytes_per_s,blocks_per_s,setup_ms_per_file,rx_cpu_us_per_kb"
+for PROTO in ${PROTOS}
+do
+    # XMODEM sends one file per run. sz picks its own CRC and subpacket
+    # length, up to 1K.
+    RUNS="${BATCHES}"
+    PCHECKS="${CHECKS}"
+    BLOCKS_SWEEP="128 1024"
+    if [ ${PROTO} = "xmodem" ]; then RUNS="1"; fi
+    if [ ${PROTO} = "zmodem" ]; then PCHECKS="crc32"; BLOCKS_SWEEP="1024"; fi
+    for CHECK in ${PCHECKS}
+    do
+        for BLOCK in ${BLOCKS_SWEEP}
+        do
+            KOPT=""
+            if [ ${BLOCK} -eq 1024 ] && [ ${PROTO} != "zmodem" ]; then KOPT="-k"; fi
+            for FILES in ${RUNS}
+            do
+                # Empty files measure the per file setup cost.
+                EMPTY=""
+                for i in $(seq 1 ${FILES}); do
+                    : > ${WORKDIR}/empty_${i}.bin
+                    EMPTY="${EMPTY} ${WORKDIR}/empty_${i}.bin"
+                done
+                read REAL CPU <<< $(run_sender ${PROTO} ${CHECK} ${KOPT} ${EMPTY})
+                SETUP=$(echo "${REAL} * 1000 / ${FILES}" | bc -l)
+                for SIZE in ${SIZES}
+                do
+                    LIST=""
+                    for i in $(seq 1 ${FILES}); do
+                        head -c ${SIZE} /dev/urandom > ${WORKDIR}/bench_${i}.bin
+                        LIST="${LIST} ${WORKDIR}/bench_${i}.bin"
+                    done
+                    read REAL CPU <<< $(run_sender ${PROTO} ${CHECK} ${KOPT} ${LIST})
+                    TOTAL=$((SIZE * FILES))
+                    BLOCKS=$(( (SIZE + BLOCK - 1) / BLOCK * FILES ))
+                    if [ -n "${CPU}" ]; then
+                        CPU_KB=$(printf "%.1f" $(echo "${CPU} * 1024 / ${TOTAL}" | bc -l))
+                    else
+                        CPU_KB=""
+                    fi
+                    printf "%s,%s,%d,%d,%d,%d,%s,%.0f,%.1f,%.1f,%s\n" \
+                        ${PROTO} ${CHECK} ${BLOCK} ${FILES} ${SIZE} ${TOTAL} ${REAL} \
+                        $(echo "${TOTAL} / ${REAL}" | bc -l) \
+                        $(echo "${BLOCKS} / ${REAL}" | bc -l) \
+                        ${SETUP} "${CPU_KB}"
+                done
+            done
+        done
+    done
+done
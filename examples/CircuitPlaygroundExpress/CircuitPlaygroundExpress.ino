@@ -146,8 +146,9 @@ uint16_t cap3vector[4] = {208, 208, 208, 208};
 uint8_t cap3idx = 0;
 
 void loop() {
-  // If file transfer finishes, wait for new file transfer
-  if (rxymodem.loop() == 0) {
+  // If file transfer finishes, wait for new file transfer. Spend at most
+  // about 2 ms on it per pass so the buttons and key macros stay responsive.
+  if (rxymodem.loop(2000) == 0) {
     load_key_macros();
     rxymodem.start_rb(&XMODEM_PORT, &FATFILESYS, true, true);  // Ymodem 1K CRC
   }
@@ -57,9 +57,18 @@
  * params.json".
  *
  * ## Receive YMODEM batch mode. The sender may send 0 or more files including
- * file names. rb receives and creates the files.
+ * file names. rb receives and creates the files. -g uses YMODEM-G streaming
+ * for error free links such as USB. -wN asks for windowed mode with up to N
+ * blocks in flight for high latency links.
  *
- *    rb
+ *    rb [-g] [-wN]
+ *
+ * ## Receive ZMODEM batch mode. Files of the same name and length are
+ * skipped. Other files of the same name are replaced, unless the sender asks
+ * for crash recovery (sz -r). Then a partial file left by an interrupted
+ * transfer is resumed from where it stopped.
+ *
+ *    rz
  *
  * ## Receive one file using XMODEM. The XMODEM protocol does not allow the
  * sender to send the filename. Do not use this unless YMODEM is not available.
@@ -67,6 +76,25 @@
  *
  *    rx <filename>
  *
+ * ## Send files using YMODEM batch mode with 1K blocks. Binary safe, unlike
+ * cat. -wN sends up to N blocks ahead if the receiver asks for windowed
+ * mode.
+ *
+ *    sb [-wN] <filename> [<filename> ...]
+ *
+ * ## Send one file using XMODEM. 128 byte blocks unless -k is given.
+ *
+ *    sx [-k] <filename>
+ *
+ * ## Print the CRC-32 and SHA-256 of a file read back from the file system,
+ * or of the last file received. Compare with zlib.crc32 or sha256sum.
+ *
+ *    sum [<filename>]
+ *
+ * ## Dump the event trace of the last transfer. Decode it with xyevent.py.
+ *
+ *    evdump
+ *
  * ## TODO maybe, not too useful
  *
  *    ren <fromfilename> <tofilename>, mv <fromfilename> <tofilename>
@@ -84,6 +112,8 @@
 #define XMODEM_PORT Serial
 
 SerialFileBrowser filebrowser(XMODEM_PORT, FATFILESYS);
+XYsha256 last_sha;    // for sum without a file name
+xyevent_t events[64]; // last transfer for evdump
 
 void setup() {
   // Initialize serial port and wait for it to open before continuing.
@@ -102,6 +132,8 @@ void setup() {
     while(1);
   }
 
+  filebrowser.setSha256(&last_sha);
+  filebrowser.setEventTrace(events, sizeof(events)/sizeof(events[0]));
   filebrowser.setup_cli();
 }
 
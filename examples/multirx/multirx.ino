@@ -0,0 +1,46 @@
+/*
+ * Receive files on several serial ports at the same time. Each port has its
+ * own XYmodem object and receives YMODEM batches into its own directory.
+ * All the receive state is in the XYmodem object so the receivers do not
+ * affect each other. Call loop() of each one in turn from the sketch loop.
+ *
+ * Written for Teensy 3.6 with the built in SD card and Serial1-Serial4.
+ */
+
+#include <xymodem.h>
+
+// select and include the header for the filesystem you want to use here
+#include <SD.h>
+#define FATFILESYS SD
+#define chipSelect BUILTIN_SDCARD
+
+HardwareSerial *ports[] = { &Serial1, &Serial2, &Serial3, &Serial4 };
+const char *dirs[] = { "/port1", "/port2", "/port3", "/port4" };
+#define NPORTS (sizeof(ports)/sizeof(ports[0]))
+
+XYmodem receivers[NPORTS];
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial && millis() < 2000) {
+    delay(100);
+  }
+  if (!FATFILESYS.begin(chipSelect)) {
+    Serial.println("Error, failed to mount filesystem!");
+    while(1);
+  }
+  for (size_t i = 0; i < NPORTS; i++) {
+    ports[i]->begin(115200);
+    FATFILESYS.mkdir(dirs[i]);
+    receivers[i].start_rb(*ports[i], FATFILESYS, dirs[i], true, true);
+  }
+}
+
+void loop() {
+  for (size_t i = 0; i < NPORTS; i++) {
+    if (receivers[i].loop() == 0) {
+      // Session over, wait for the next one.
+      receivers[i].start_rb(*ports[i], FATFILESYS, dirs[i], true, true);
+    }
+  }
+}
@@ -1,5 +1,31 @@
+/*
+ * Receive files using YMODEM batch mode, over and over. Each session may
+ * bring any number of files, which are written to the root of the SD card.
+ * bench.sh measures the throughput of this sketch with lrzsz sb.
+ *
+ * Written for an SD card on the default SPI chip select. Teensy 3.6 uses
+ * the built in SD card. Arduino Zero receives on the native USB port.
+ */
+
 #include <xymodem.h>
 
+// select and include the header for the filesystem you want to use here
+#include <SD.h>
+#define FATFILESYS SD
+
+// Teensy 3.6
+#if defined(__MK66FX1M0__)
+#define chipSelect BUILTIN_SDCARD
+#define XMODEM_PORT Serial
+// Arduino Zero
+#elif defined(ARDUINO_SAMD_ZERO)
+#define chipSelect SS
+#define XMODEM_PORT SerialUSB
+#else
+#define chipSelect SS
+#define XMODEM_PORT Serial
+#endif
+
 #define DEBUG_ON 0
 
 #if DEBUG_ON
@@ -19,6 +45,7 @@
 #endif
 
 XYmodem rxymodem;
+bool fs_ok = false;
 
 void setup()
 {
@@ -28,12 +55,13 @@ void setup()
 #endif
   delay(2000);
 
-  dbprint("Initializing Flash file system...");
-  if (rxymodem.begin()) {
+  dbprint("Initializing SD card...");
+  if (!FATFILESYS.begin(chipSelect)) {
     dbprintln("initialization failed!");
     return;
   }
   dbprintln("initialization done.");
+  fs_ok = true;
 
   // One big difference between Xmodem and Ymodem. Ymodem sends the filename
   // and size for 1 or more files (also known as batch mode). The file size
@@ -41,14 +69,15 @@ void setup()
   // Ymodem tranferred files should not be padded.
   // 1K = 1024 bytes blocks instead of 128 byte blocks.
   // CRC = use 16-bit CRC instead of 1 byte checksum
-  //rxymodem.start_rx(&XMODEM_PORT, "junk.dat", true, true);  // Xmodem 1K CRC
-  rxymodem.start_rb(&XMODEM_PORT, &FATFILESYS, true, true);  // Ymodem 1K CRC
+  //rxymodem.start_rx(XMODEM_PORT, FATFILESYS, "/junk.dat", true, true);  // Xmodem 1K CRC
+  rxymodem.start_rb(XMODEM_PORT, FATFILESYS, true, true);  // Ymodem 1K CRC
 }
 
 void loop()
 {
+  if (!fs_ok) return;
   if (rxymodem.loop() == 0) {
-    //rxymodem.start_rx(&XMODEM_PORT, "morejunk.dat", true, true);  // Xmodem 1K CRC
-    rxymodem.start_rb(&XMODEM_PORT, &FATFILESYS, true, true);  // Ymodem 1K CRC
+    //rxymodem.start_rx(XMODEM_PORT, FATFILESYS, "/morejunk.dat", true, true);  // Xmodem 1K CRC
+    rxymodem.start_rb(XMODEM_PORT, FATFILESYS, true, true);  // Ymodem 1K CRC
   }
 }
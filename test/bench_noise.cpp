@@ -0,0 +1,171 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Recovery on a lossy link. The reference sender sends a YMODEM file
+ * through XYnoisyStream to loop() over a simulated 115200 baud line with
+ * 5 ms latency each way, for a set of fault profiles and seeds. Prints one
+ * CSV line per profile:
+ *
+ *    profile,runs,failed,faults,goodput_Bps,sender_resends,sender_timeouts,
+ *    naks,timeouts,duplicates,recoveries,recover_p50_ms,recover_p90_ms,
+ *    recover_max_ms
+ *
+ * goodput is file bytes per simulated second, averaged over the runs. A
+ * recovery is the time from a fault to the next block accepted after it.
+ *
+ *    bench_noise [seeds]
+ */
+
+#include <xymodem.h>
+#include <xynoise.h>
+#include <hostfs.h>
+#include <hoststream.h>
+#include "check.h"
+#include "refsender.h"
+#include "line.h"
+#include <algorithm>
+#include <random>
+
+typedef struct {
+  const char *name;
+  uint32_t bitflip_ppm;
+  uint32_t drop_ppm;
+  uint32_t trunc_ppm;
+  uint32_t stall_ppm;
+  uint32_t ackdrop_ppm;
+} profile_t;
+
+static const profile_t profiles[] = {
+  { "clean",     0,   0,    0,   0,     0 },
+  { "bitflip",   200, 0,    0,   0,     0 },
+  { "drop",      0,   100,  0,   0,     0 },
+  { "trunc",     0,   0,    5000, 0,    0 },
+  { "stall",     0,   0,    0,   100,   0 },
+  { "ackdrop",   0,   0,    0,   0,     20000 },
+  { "mixed",     100, 50,   2000, 50,   10000 },
+};
+
+typedef struct {
+  uint32_t runs;
+  uint32_t failed;
+  uint32_t faults;
+  double goodput;
+  uint32_t sender_resends;
+  uint32_t sender_timeouts;
+  uint32_t naks;
+  uint32_t timeouts;
+  uint32_t duplicates;
+  std::vector<uint32_t> recover_ms;
+} result_t;
+
+static bool run(const profile_t &p, uint32_t seed, const RefFile &file, result_t &r)
+{
+  Pipe s_out, r_in, r_out, s_in;
+  Line down(&s_out, &r_in), up(&r_out, &s_in);
+  PipeStream port(&r_in, &r_out);
+  XYnoisyStream noisy(port, seed);
+  noisy.bitflip_ppm = p.bitflip_ppm;
+  noisy.drop_ppm = p.drop_ppm;
+  noisy.trunc_ppm = p.trunc_ppm;
+  noisy.stall_ppm = p.stall_ppm;
+  noisy.ackdrop_ppm = p.ackdrop_ppm;
+  MemFS fs;
+  XYmodem x;
+  RefSender s(&s_out, &s_in);
+  s.files.push_back(file);
+  s.retry_ms = 5000;
+
+  host_clock_set(0);
+  x.start_rb(noisy, fs, true, true);
+  uint32_t faults = 0;
+  uint32_t blocks = 0;
+  bool fault_pending = false;
+  uint32_t fault_ms = 0;
+  uint32_t now = 0;
+  for (now = 0; now < 600000; now++) {
+    host_clock_set(now);
+    down.tick(now);
+    up.tick(now);
+    s.step();
+    if (x.loop() == 0) break;
+    // A lost ACK comes after the block it is for, so look at blocks first.
+    if (x.getStats().blocks != blocks) {
+      blocks = x.getStats().blocks;
+      if (fault_pending) r.recover_ms.push_back(now - fault_ms);
+      fault_pending = false;
+    }
+    uint32_t f = noisy.counts.bitflips + noisy.counts.drops +
+      noisy.counts.truncs + noisy.counts.stalls + noisy.counts.ackdrops;
+    if ((f != faults) && !fault_pending) {
+      fault_pending = true;
+      fault_ms = now;
+    }
+    faults = f;
+  }
+  const XYmodem::stats_t &st = x.getStats();
+  bool good = (fs.files["/" + file.name] == file.data);
+  r.runs++;
+  r.failed += !good;
+  r.faults += faults;
+  r.goodput += (now > 0) ? (double)st.bytes * 1000 / now : 0;
+  r.sender_resends += s.resent;
+  r.sender_timeouts += s.timeouts;
+  r.naks += st.naks;
+  r.timeouts += st.timeouts;
+  r.duplicates += st.duplicates;
+  return good;
+}
+
+static uint32_t percentile(std::vector<uint32_t> &v, int pct)
+{
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[(v.size() - 1) * pct / 100];
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t seeds = (argc > 1) ? atoi(argv[1]) : 5;
+  std::mt19937 rng(1);
+  RefFile file;
+  file.name = "n.bin";
+  for (int i = 0; i < 50000; i++) file.data.push_back(rng());
+
+  printf("profile,runs,failed,faults,goodput_Bps,sender_resends,sender_timeouts,"
+      "naks,timeouts,duplicates,recoveries,recover_p50_ms,recover_p90_ms,"
+      "recover_max_ms\n");
+  for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+    result_t r = result_t();
+    for (uint32_t seed = 1; seed <= seeds; seed++) {
+      CHECK(run(profiles[i], seed, file, r));
+    }
+    printf("%s,%u,%u,%u,%.0f,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", profiles[i].name,
+        r.runs, r.failed, r.faults, r.goodput / r.runs, r.sender_resends,
+        r.sender_timeouts, r.naks, r.timeouts, r.duplicates,
+        (unsigned)r.recover_ms.size(), percentile(r.recover_ms, 50),
+        percentile(r.recover_ms, 90), percentile(r.recover_ms, 100));
+  }
+  return check_report("noise");
+}
@@ -0,0 +1,163 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Fuzz target for the receive state machine. The first byte of an input
+ * picks the configuration, the second the largest piece handed to feed()
+ * at a time, the rest is the line. Time moves on between pieces so the
+ * timeouts run too. Built with -DXYMODEM_FUZZ=ON (clang) this is a
+ * libFuzzer target:
+ *
+ *    ./fuzz_rx corpus/
+ *
+ * Otherwise main() runs a fixed number of seeded inputs, random bytes and
+ * mutated good transfers, as a ctest, best with -DXYMODEM_SANITIZE=ON.
+ *
+ *    fuzz_rx [inputs]
+ */
+
+#include <xymodem.h>
+#include <hostfs.h>
+#include <hoststream.h>
+#include "check.h"
+#include "refsender.h"
+#include <random>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  static uint8_t pool[4 * 1032];
+  static uint8_t co[512];
+  static uint8_t vbuf[256];
+  static xyevent_t events[16];
+
+  if (size < 2) return 0;
+  uint8_t cfg = data[0];
+  size_t max_piece = data[1] + 1;
+  data += 2;
+  size -= 2;
+
+  MemFS fs;
+  Pipe in, out;
+  PipeStream port(&in, &out);
+  XYmodem x;
+  bool use_1k = cfg & 0x01;
+  bool crc = cfg & 0x02;
+  bool streaming = cfg & 0x04;
+  bool xmodem = cfg & 0x80;
+  if (cfg & 0x08) x.setWindow(4);
+  if (cfg & 0x10) x.setWriteBehind(pool, sizeof(pool));
+  if (cfg & 0x20) x.setWriteCoalescing(co, sizeof(co));
+  if (cfg & 0x40) x.setVerify(vbuf, sizeof(vbuf));
+  x.setEventTrace(events, 16);
+  host_clock_set(0);
+  if (xmodem) x.start_rx(port, fs, "x.bin", use_1k, crc);
+  else x.start_rb(fs, "/", use_1k, crc, streaming);
+
+  uint8_t reply[XYmodem::REPLY_MAX];
+  while ((size > 0) && x.active()) {
+    size_t n = min(size, max_piece);
+    if (xmodem) {
+      in.q.insert(in.q.end(), data, data + n);
+      x.loop();
+      out.q.clear();
+    }
+    else {
+      size_t r = x.feed(data, n, reply, sizeof(reply));
+      if (r > sizeof(reply)) abort();
+    }
+    // Some pieces arrive late enough to time out.
+    host_clock_advance((data[0] & 0x0F) * ((data[n - 1] & 0x80) ? 500 : 1));
+    data += n;
+    size -= n;
+  }
+  // Run the timers out.
+  for (int i = 0; (i < 100) && x.active(); i++) {
+    host_clock_advance(1000);
+    if (xmodem) x.loop();
+    else x.feed(NULL, 0, reply, sizeof(reply));
+  }
+  return 0;
+}
+
+#ifndef XYMODEM_LIBFUZZER
+static std::mt19937 rng(1);
+
+// A good YMODEM batch of two files, for mutating.
+static std::vector<uint8_t> good_stream(bool use_1k, bool crc)
+{
+  std::vector<uint8_t> s;
+  const char *names[] = { "a.bin", "b.bin" };
+  for (int f = 0; f < 2; f++) {
+    size_t len = rng() % 3000;
+    std::vector<uint8_t> d(len);
+    for (size_t i = 0; i < len; i++) d[i] = rng();
+    std::string hdr = std::string(names[f]) + '\0' + std::to_string(len);
+    std::vector<uint8_t> b = ref_block(0, (const uint8_t *)hdr.data(), hdr.size(), 128, crc, 0);
+    s.insert(s.end(), b.begin(), b.end());
+    uint8_t num = 1;
+    for (size_t off = 0; off < len; ) {
+      size_t size = (use_1k && (len - off > 128)) ? 1024 : 128;
+      size_t n = min(size, len - off);
+      b = ref_block(num++, d.data() + off, n, size, crc, 0x1A);
+      s.insert(s.end(), b.begin(), b.end());
+      off += n;
+    }
+    s.push_back(EOT);
+  }
+  std::vector<uint8_t> b = ref_block(0, NULL, 0, 128, crc, 0);
+  s.insert(s.end(), b.begin(), b.end());
+  return s;
+}
+
+int main(int argc, char **argv)
+{
+  int inputs = (argc > 1) ? atoi(argv[1]) : 2000;
+
+  for (int i = 0; i < inputs; i++) {
+    std::vector<uint8_t> in;
+    uint8_t cfg = rng();
+    in.push_back(cfg);
+    in.push_back(rng());
+    if (i & 1) {
+      size_t len = rng() % 4000;
+      for (size_t k = 0; k < len; k++) in.push_back(rng());
+    }
+    else {
+      std::vector<uint8_t> s = good_stream(cfg & 0x01, cfg & 0x02);
+      for (int m = rng() % 8; m > 0; m--) {
+        size_t at = rng() % s.size();
+        switch (rng() % 3) {
+          case 0: s[at] ^= 1 << (rng() % 8); break;
+          case 1: s.erase(s.begin() + at); break;
+          default: s.insert(s.begin() + at, (uint8_t)rng()); break;
+        }
+      }
+      in.insert(in.end(), s.begin(), s.end());
+    }
+    LLVMFuzzerTestOneInput(in.data(), in.size());
+  }
+  printf("%d inputs\n", inputs);
+  return check_report("fuzz");
+}
+#endif
@@ -0,0 +1,62 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * One direction of a simulated serial line for the host tests. Bytes put
+ * in from leave at bytes_per_ms, 11 for 115200 baud, and come out of to
+ * latency_ms later. Call tick() once per simulated millisecond.
+ */
+
+#ifndef _LINE_H_
+#define _LINE_H_
+
+#include <hoststream.h>
+#include <utility>
+
+class Line {
+  public:
+    Line(Pipe *from, Pipe *to, int bytes_per_ms=11, uint32_t latency_ms=5) :
+      from(from), to(to), bytes_per_ms(bytes_per_ms), latency_ms(latency_ms) {};
+
+    void tick(uint32_t now) {
+      for (int i = 0; (i < bytes_per_ms) && !from->q.empty(); i++) {
+        flight.push_back(std::make_pair(now + latency_ms, from->q.front()));
+        from->q.pop_front();
+      }
+      while (!flight.empty() && (flight.front().first <= now)) {
+        to->q.push_back(flight.front().second);
+        flight.pop_front();
+      }
+    };
+    bool idle(void) { return from->q.empty() && flight.empty(); };
+
+  private:
+    Pipe *from;
+    Pipe *to;
+    int bytes_per_ms;
+    uint32_t latency_ms;
+    std::deque<std::pair<uint32_t, uint8_t> > flight;
+};
+
+#endif /* _LINE_H_ */
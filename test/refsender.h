@@ -0,0 +1,230 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Reference XMODEM/YMODEM sender for the host tests, written separately
+ * from the send side of XYmodem so the two do not share mistakes. It
+ * writes blocks into one Pipe and reads the replies from another, one
+ * reply byte per step(). Answers 'C' with CRC, NAK with checksum and 'G'
+ * with YMODEM-G streaming. corrupt_every flips a bit in every nth block
+ * sent. With retry_ms set it sends the last block or EOT again when the
+ * receiver has said nothing for that long, by millis().
+ */
+
+#ifndef _REFSENDER_H_
+#define _REFSENDER_H_
+
+#include <hoststream.h>
+#include <xymodem.h>
+#include <string>
+#include <vector>
+
+struct RefFile {
+  std::string name;
+  std::vector<uint8_t> data;
+};
+
+static inline uint16_t ref_crc16(const uint8_t *p, size_t len)
+{
+  uint16_t crc = 0;
+  while (len--) {
+    crc ^= (uint16_t)*p++ << 8;
+    for (int i = 0; i < 8; i++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+// Block num with len bytes of data padded to size, and its CRC or checksum.
+static inline std::vector<uint8_t> ref_block(uint8_t num, const uint8_t *data,
+    size_t len, size_t size, bool crc, uint8_t pad)
+{
+  std::vector<uint8_t> b;
+  b.push_back((size == 1024) ? STX : SOH);
+  b.push_back(num);
+  b.push_back(~num);
+  b.insert(b.end(), data, data + len);
+  b.resize(3 + size, pad);
+  if (crc) {
+    uint16_t c = ref_crc16(b.data() + 3, size);
+    b.push_back(c >> 8);
+    b.push_back(c & 0xFF);
+  }
+  else {
+    uint8_t sum = 0;
+    for (size_t i = 0; i < size; i++) sum += b[3 + i];
+    b.push_back(sum);
+  }
+  return b;
+}
+
+class RefSender {
+  public:
+    enum state_t { WAIT_START, WAIT_ACK, WAIT_EOT_ACK, WAIT_DATA_START, DONE, CANCELLED };
+
+    RefSender(Pipe *out, Pipe *in) : out(out), in(in) {};
+
+    std::vector<RefFile> files;
+    bool ymodem = true;
+    bool use_1k = true;
+    int corrupt_every = 0;
+    uint32_t retry_ms = 0;
+    state_t state = WAIT_START;
+    uint32_t blocks_sent = 0;
+    uint32_t resent = 0;
+    uint32_t timeouts = 0;
+
+    void step(void) {
+      if (in->q.empty()) {
+        if ((retry_ms != 0) && (millis() - heard_ms >= retry_ms)) {
+          heard_ms = millis();
+          if (state == WAIT_ACK) {
+            timeouts++;
+            put(last);
+          }
+          else if (state == WAIT_EOT_ACK) {
+            timeouts++;
+            out->q.push_back(EOT);
+          }
+        }
+        return;
+      }
+      heard_ms = millis();
+      uint8_t c = in->q.front();
+      in->q.pop_front();
+      switch (state) {
+        case WAIT_START:
+          if ((c == 'C') || (c == NAK) || (c == 'G')) {
+            crc = (c != NAK);
+            streaming = (c == 'G');
+            if (ymodem) {
+              send_header();
+              state = (last_header) ? ((streaming) ? DONE : WAIT_ACK) :
+                (streaming) ? WAIT_DATA_START : WAIT_ACK;
+            }
+            else {
+              start_data();
+            }
+          }
+          break;
+        case WAIT_DATA_START:
+          if ((c == 'C') || (c == NAK) || (c == 'G')) start_data();
+          break;
+        case WAIT_ACK:
+          if (c == ACK) {
+            if (header) state = (last_header) ? DONE : WAIT_DATA_START;
+            else next_data();
+          }
+          else if ((c == NAK) || (c == 'C')) {
+            resent++;
+            put(last);
+          }
+          else if (c == CAN) {
+            state = CANCELLED;
+          }
+          break;
+        case WAIT_EOT_ACK:
+          if (c == ACK) {
+            file++;
+            state = (ymodem) ? WAIT_START : DONE;
+          }
+          else if (c == NAK) {
+            out->q.push_back(EOT);
+          }
+          else if (c == CAN) {
+            state = CANCELLED;
+          }
+          break;
+        default:
+          break;
+      }
+    };
+
+  private:
+    Pipe *out;
+    Pipe *in;
+    size_t file = 0;
+    size_t offset = 0;
+    uint8_t block = 0;
+    bool crc = true;
+    bool streaming = false;
+    bool header = false;
+    bool last_header = false;
+    std::vector<uint8_t> last;
+    uint32_t heard_ms = 0;
+
+    void put(const std::vector<uint8_t> &b) {
+      out->q.insert(out->q.end(), b.begin(), b.end());
+    };
+
+    void send_block(uint8_t num, const uint8_t *data, size_t len, size_t size, uint8_t pad) {
+      std::vector<uint8_t> b = ref_block(num, data, len, size, crc, pad);
+      last = b;
+      blocks_sent++;
+      if ((corrupt_every != 0) && (blocks_sent % corrupt_every == 0)) {
+        b[3 + size / 2] ^= 0x40;
+      }
+      put(b);
+    };
+
+    void send_header(void) {
+      std::vector<uint8_t> d;
+      last_header = (file >= files.size());
+      if (!last_header) {
+        std::string len = std::to_string(files[file].data.size());
+        d.insert(d.end(), files[file].name.begin(), files[file].name.end());
+        d.push_back(0);
+        d.insert(d.end(), len.begin(), len.end());
+      }
+      header = true;
+      send_block(0, d.data(), d.size(), 128, 0);
+    };
+
+    void start_data(void) {
+      block = 0;
+      offset = 0;
+      header = false;
+      next_data();
+      if (streaming) {
+        while (state == WAIT_ACK) next_data();
+      }
+    };
+
+    void next_data(void) {
+      const std::vector<uint8_t> &d = files[file].data;
+      if (offset >= d.size()) {
+        out->q.push_back(EOT);
+        state = WAIT_EOT_ACK;
+        return;
+      }
+      size_t size = (use_1k && (d.size() - offset > 128)) ? 1024 : 128;
+      size_t len = min(size, d.size() - offset);
+      send_block(++block, d.data() + offset, len, size, 0x1A);
+      offset += len;
+      state = WAIT_ACK;
+    };
+};
+
+#endif /* _REFSENDER_H_ */
@@ -0,0 +1,136 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Just enough of the Arduino core to build the library on a Linux host for
+ * tests, benchmarks and profiling. Not used by the Arduino IDE.
+ */
+
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+
+#define HEX 16
+#define DEC 10
+
+#ifdef __cplusplus
+
+template <class A, class B> inline A min(A a, B b) { return (a < (A)b) ? a : (A)b; }
+template <class A, class B> inline A max(A a, B b) { return (a > (A)b) ? a : (A)b; }
+
+/*
+ * Host clock behind millis() and micros(). It is simulated unless
+ * host_clock_real(true): it starts at 0 and only moves when the test moves
+ * it, so every run of a test sees the same times. delay() moves it too.
+ */
+void host_clock_real(bool on);
+void host_clock_set(uint32_t ms);
+void host_clock_advance(uint32_t ms);
+void host_clock_advance_us(uint32_t us);
+uint32_t millis(void);
+uint32_t micros(void);
+void delay(uint32_t ms);
+
+/*
+ * yield() calls hook, for example to run the consumer side of write-behind
+ * while the engine waits for it. NULL = none.
+ */
+void host_yield_hook(void (*hook)(void));
+void yield(void);
+
+class Print {
+  public:
+    virtual ~Print() {};
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t len) {
+      size_t n = 0;
+      while ((n < len) && (write(buf[n]) == 1)) n++;
+      return n;
+    };
+    size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); };
+    size_t write(const char *buf, size_t len) { return write((const uint8_t *)buf, len); };
+    virtual int availableForWrite(void) { return 0; };
+    virtual void flush(void) {};
+
+    size_t print(const char *s) { return write(s); };
+    size_t print(char c) { return write((uint8_t)c); };
+    size_t print(unsigned char v, int base=DEC) { return print((unsigned long)v, base); };
+    size_t print(int v, int base=DEC) { return print((long)v, base); };
+    size_t print(unsigned int v, int base=DEC) { return print((unsigned long)v, base); };
+    size_t print(long v, int base=DEC) {
+      char buf[24];
+      snprintf(buf, sizeof(buf), (base == HEX) ? "%lX" : "%ld", v);
+      return print(buf);
+    };
+    size_t print(unsigned long v, int base=DEC) {
+      char buf[24];
+      snprintf(buf, sizeof(buf), (base == HEX) ? "%lX" : "%lu", v);
+      return print(buf);
+    };
+    size_t print(unsigned long long v, int base=DEC) { return print((unsigned long)v, base); };
+    size_t print(double v, int digits=2) {
+      char buf[40];
+      snprintf(buf, sizeof(buf), "%.*f", digits, v);
+      return print(buf);
+    };
+    size_t println(void) { return print("\r\n"); };
+    template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); };
+    template <typename T> size_t println(T v, int base) { size_t n = print(v, base); return n + println(); };
+};
+
+/*
+ * readBytes() does not wait, it stops when no more bytes are available.
+ */
+class Stream : public Print {
+  public:
+    virtual int available(void) = 0;
+    virtual int read(void) = 0;
+    virtual int peek(void) = 0;
+    void setTimeout(unsigned long ms) { timeout = ms; };
+    size_t readBytes(char *buf, size_t len) {
+      size_t n = 0;
+      while (n < len) {
+        int c = read();
+        if (c < 0) break;
+        buf[n++] = c;
+      }
+      return n;
+    };
+    size_t readBytes(uint8_t *buf, size_t len) { return readBytes((char *)buf, len); };
+    bool find(const char *target) { (void)target; return false; };
+
+  protected:
+    unsigned long timeout = 1000;
+};
+
+#endif /* __cplusplus */
+
+#endif /* _HOST_ARDUINO_H_ */
@@ -0,0 +1,124 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * FS and File as the ESP32 and SdFat style cores have them, for the host
+ * build. The implementations are in hostfs.h.
+ */
+
+#ifndef _HOST_FS_H_
+#define _HOST_FS_H_
+
+#include <Arduino.h>
+#include <memory>
+
+#define FILE_READ  0
+#define FILE_WRITE 1
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File;
+
+class FileImpl {
+  public:
+    virtual ~FileImpl() {};
+    virtual size_t read(uint8_t *buf, size_t len) = 0;
+    virtual size_t write(const uint8_t *buf, size_t len) = 0;
+    virtual bool seek(uint32_t pos, SeekMode mode) = 0;
+    virtual uint32_t position(void) = 0;
+    virtual uint32_t size(void) = 0;
+    virtual void flush(void) {};
+    virtual void close(void) = 0;
+    virtual const char *name(void) = 0;
+    virtual bool isDirectory(void) { return false; };
+    virtual File openNextFile(void);
+    virtual void rewindDirectory(void) {};
+};
+
+/*
+ * A handle. Copies share the open file, as on the boards.
+ */
+class File : public Stream {
+  public:
+    File() {};
+    File(FileImpl *impl) : impl(impl) {};
+
+    virtual size_t write(uint8_t c) { return write(&c, 1); };
+    virtual size_t write(const uint8_t *buf, size_t len) {
+      return (impl) ? impl->write(buf, len) : 0;
+    };
+    using Print::write;
+    virtual int available(void) {
+      return (impl) ? (int)(impl->size() - impl->position()) : 0;
+    };
+    virtual int read(void) {
+      uint8_t c;
+      return (read(&c, 1) == 1) ? c : -1;
+    };
+    int read(uint8_t *buf, size_t len) {
+      return (impl) ? (int)impl->read(buf, len) : -1;
+    };
+    int read(void *buf, size_t len) { return read((uint8_t *)buf, len); };
+    virtual int peek(void) {
+      uint32_t pos = position();
+      int c = read();
+      seek(pos);
+      return c;
+    };
+    virtual void flush(void) { if (impl) impl->flush(); };
+    bool seek(uint32_t pos, SeekMode mode=SeekSet) {
+      return (impl) ? impl->seek(pos, mode) : false;
+    };
+    uint32_t position(void) { return (impl) ? impl->position() : 0; };
+    uint32_t size(void) { return (impl) ? impl->size() : 0; };
+    void close(void) {
+      if (impl) impl->close();
+      impl.reset();
+    };
+    const char *name(void) { return (impl) ? impl->name() : ""; };
+    bool isDirectory(void) { return (impl) ? impl->isDirectory() : false; };
+    File openNextFile(void) { return (impl) ? impl->openNextFile() : File(); };
+    void rewindDirectory(void) { if (impl) impl->rewindDirectory(); };
+    operator bool() { return (bool)impl; };
+
+  private:
+    std::shared_ptr<FileImpl> impl;
+};
+
+inline File FileImpl::openNextFile(void) { return File(); }
+
+class FS {
+  public:
+    virtual ~FS() {};
+    virtual File open(const char *path, uint8_t mode=FILE_READ) = 0;
+    virtual bool exists(const char *path) = 0;
+    virtual bool remove(const char *path) = 0;
+    virtual bool rename(const char *from, const char *to) = 0;
+    virtual bool mkdir(const char *path) = 0;
+    virtual bool rmdir(const char *path) = 0;
+    virtual uint64_t totalSize(void) { return 0; };
+    virtual uint64_t usedSize(void) { return 0; };
+};
+
+#endif /* _HOST_FS_H_ */
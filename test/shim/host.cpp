@@ -0,0 +1,133 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Arduino.h>
+#include <hoststream.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+static bool clock_real = false;
+static uint64_t clock_us = 0;
+static void (*yield_hook)(void) = NULL;
+
+static uint64_t real_us(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void host_clock_real(bool on)
+{
+  clock_real = on;
+}
+
+void host_clock_set(uint32_t ms)
+{
+  clock_us = (uint64_t)ms * 1000;
+}
+
+void host_clock_advance(uint32_t ms)
+{
+  clock_us += (uint64_t)ms * 1000;
+}
+
+void host_clock_advance_us(uint32_t us)
+{
+  clock_us += us;
+}
+
+uint32_t millis(void)
+{
+  return (uint32_t)(((clock_real) ? real_us() : clock_us) / 1000);
+}
+
+uint32_t micros(void)
+{
+  return (uint32_t)((clock_real) ? real_us() : clock_us);
+}
+
+void delay(uint32_t ms)
+{
+  if (clock_real) {
+    struct timespec ts = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000 };
+    nanosleep(&ts, NULL);
+  }
+  else {
+    host_clock_advance(ms);
+  }
+}
+
+void host_yield_hook(void (*hook)(void))
+{
+  yield_hook = hook;
+}
+
+void yield(void)
+{
+  if (yield_hook != NULL) yield_hook();
+}
+
+size_t FdStream::write(const uint8_t *buf, size_t len)
+{
+  size_t done = 0;
+  while (done < len) {
+    ssize_t n = ::write(fd, buf + done, len - done);
+    if (n < 0) {
+      if ((errno == EAGAIN) || (errno == EINTR)) continue;
+      break;
+    }
+    done += n;
+  }
+  return done;
+}
+
+int FdStream::available(void)
+{
+  int n = 0;
+  if (ioctl(fd, FIONREAD, &n) != 0) n = 0;
+  return n + (rx_len - rx_head);
+}
+
+int FdStream::peek(void)
+{
+  if (rx_head == rx_len) {
+    int n = 0;
+    if ((ioctl(fd, FIONREAD, &n) != 0) || (n == 0)) return -1;
+    ssize_t got = ::read(fd, rx_buf, sizeof(rx_buf));
+    if (got <= 0) return -1;
+    rx_head = 0;
+    rx_len = got;
+  }
+  return rx_buf[rx_head];
+}
+
+int FdStream::read(void)
+{
+  int c = peek();
+  if (c >= 0) rx_head++;
+  return c;
+}
@@ -0,0 +1,307 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <hostfs.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+static const char *base_name(const std::string &path)
+{
+  size_t slash = path.rfind('/');
+  return path.c_str() + ((slash == std::string::npos) ? 0 : slash + 1);
+}
+
+// Pathname with no trailing '/' except for the root.
+static std::string clean_path(const char *path)
+{
+  std::string p = (path[0] == '/') ? path : std::string("/") + path;
+  while ((p.size() > 1) && (p[p.size() - 1] == '/')) p.erase(p.size() - 1);
+  return p;
+}
+
+class MemFile : public FileImpl {
+  public:
+    MemFile(MemFS *fs, const std::string &path) : fs(fs), path(path) {
+      data = &fs->files[path];
+      fs->open_files++;
+    };
+
+    virtual size_t read(uint8_t *buf, size_t len) {
+      size_t n = (pos < data->size()) ? min(len, data->size() - pos) : 0;
+      memcpy(buf, data->data() + pos, n);
+      pos += n;
+      return n;
+    };
+    virtual size_t write(const uint8_t *buf, size_t len) {
+      fs->writes++;
+      if (fs->written >= fs->fail_after) return 0;
+      if (len > fs->fail_after - fs->written) len = fs->fail_after - fs->written;
+      fs->written += len;
+      if (data->size() < pos + len) data->resize(pos + len);
+      memcpy(data->data() + pos, buf, len);
+      pos += len;
+      return len;
+    };
+    virtual bool seek(uint32_t pos, SeekMode mode) {
+      size_t to = (mode == SeekSet) ? pos :
+        (mode == SeekCur) ? this->pos + pos : data->size() + pos;
+      if (to > data->size()) return false;
+      this->pos = to;
+      return true;
+    };
+    virtual uint32_t position(void) { return pos; };
+    virtual uint32_t size(void) { return data->size(); };
+    virtual void close(void) {
+      if (open) fs->open_files--;
+      open = false;
+    };
+    virtual const char *name(void) { return base_name(path); };
+
+  private:
+    MemFS *fs;
+    std::string path;
+    std::vector<uint8_t> *data;
+    size_t pos = 0;
+    bool open = true;
+};
+
+class MemDir : public FileImpl {
+  public:
+    MemDir(MemFS *fs, const std::string &path) : fs(fs), path(path) {
+      prefix = (path == "/") ? path : path + "/";
+    };
+
+    virtual size_t read(uint8_t *buf, size_t len) { (void)buf; (void)len; return 0; };
+    virtual size_t write(const uint8_t *buf, size_t len) { (void)buf; (void)len; return 0; };
+    virtual bool seek(uint32_t pos, SeekMode mode) { (void)pos; (void)mode; return false; };
+    virtual uint32_t position(void) { return 0; };
+    virtual uint32_t size(void) { return 0; };
+    virtual void close(void) {};
+    virtual const char *name(void) { return base_name(path); };
+    virtual bool isDirectory(void) { return true; };
+    virtual File openNextFile(void) {
+      // Directories first, then files, both in name order.
+      std::vector<std::string> entries;
+      for (std::set<std::string>::iterator i = fs->dirs.begin(); i != fs->dirs.end(); ++i) {
+        if (child(*i)) entries.push_back(*i);
+      }
+      for (std::map<std::string, std::vector<uint8_t> >::iterator i = fs->files.begin();
+          i != fs->files.end(); ++i) {
+        if (child(i->first)) entries.push_back(i->first);
+      }
+      if (next >= entries.size()) return File();
+      return fs->open(entries[next++].c_str());
+    };
+    virtual void rewindDirectory(void) { next = 0; };
+
+  private:
+    MemFS *fs;
+    std::string path;
+    std::string prefix;
+    size_t next = 0;
+
+    bool child(const std::string &p) {
+      return (p.size() > prefix.size()) && (p.compare(0, prefix.size(), prefix) == 0) &&
+        (p.find('/', prefix.size()) == std::string::npos);
+    };
+};
+
+File MemFS::open(const char *path, uint8_t mode)
+{
+  std::string p = clean_path(path);
+  if (dirs.count(p)) return File(new MemDir(this, p));
+  if ((mode == FILE_READ) && !files.count(p)) return File();
+  if (!dirs.count(p.substr(0, max((size_t)1, p.rfind('/'))))) return File();
+  MemFile *f = new MemFile(this, p);
+  if (mode == FILE_WRITE) f->seek(0, SeekEnd);
+  return File(f);
+}
+
+bool MemFS::exists(const char *path)
+{
+  std::string p = clean_path(path);
+  return (files.count(p) != 0) || (dirs.count(p) != 0);
+}
+
+bool MemFS::remove(const char *path)
+{
+  return files.erase(clean_path(path)) != 0;
+}
+
+bool MemFS::rename(const char *from, const char *to)
+{
+  std::string f = clean_path(from);
+  std::string t = clean_path(to);
+  if (!files.count(f) || exists(t.c_str())) return false;
+  files[t].swap(files[f]);
+  files.erase(f);
+  return true;
+}
+
+bool MemFS::mkdir(const char *path)
+{
+  std::string p = clean_path(path);
+  if (exists(p.c_str())) return false;
+  dirs.insert(p);
+  return true;
+}
+
+bool MemFS::rmdir(const char *path)
+{
+  std::string p = clean_path(path);
+  if (p == "/") return false;
+  return dirs.erase(p) != 0;
+}
+
+uint64_t MemFS::usedSize(void)
+{
+  uint64_t used = 0;
+  for (std::map<std::string, std::vector<uint8_t> >::iterator i = files.begin();
+      i != files.end(); ++i) {
+    used += i->second.size();
+  }
+  return used;
+}
+
+class PosixFile : public FileImpl {
+  public:
+    PosixFile(int fd, const std::string &path) : fd(fd), path(path) {};
+    virtual ~PosixFile() { close(); };
+
+    virtual size_t read(uint8_t *buf, size_t len) {
+      ssize_t n = ::read(fd, buf, len);
+      return (n > 0) ? n : 0;
+    };
+    virtual size_t write(const uint8_t *buf, size_t len) {
+      ssize_t n = ::write(fd, buf, len);
+      return (n > 0) ? n : 0;
+    };
+    virtual bool seek(uint32_t pos, SeekMode mode) {
+      int whence = (mode == SeekSet) ? SEEK_SET : (mode == SeekCur) ? SEEK_CUR : SEEK_END;
+      return lseek(fd, pos, whence) >= 0;
+    };
+    virtual uint32_t position(void) { return lseek(fd, 0, SEEK_CUR); };
+    virtual uint32_t size(void) {
+      struct stat st;
+      return (fstat(fd, &st) == 0) ? st.st_size : 0;
+    };
+    virtual void close(void) {
+      if (fd >= 0) ::close(fd);
+      fd = -1;
+    };
+    virtual const char *name(void) { return base_name(path); };
+
+  private:
+    int fd;
+    std::string path;
+};
+
+class PosixDir : public FileImpl {
+  public:
+    PosixDir(PosixFS *fs, DIR *dir, const std::string &path) :
+      fs(fs), dir(dir), path(path) {};
+    virtual ~PosixDir() { close(); };
+
+    virtual size_t read(uint8_t *buf, size_t len) { (void)buf; (void)len; return 0; };
+    virtual size_t write(const uint8_t *buf, size_t len) { (void)buf; (void)len; return 0; };
+    virtual bool seek(uint32_t pos, SeekMode mode) { (void)pos; (void)mode; return false; };
+    virtual uint32_t position(void) { return 0; };
+    virtual uint32_t size(void) { return 0; };
+    virtual void close(void) {
+      if (dir != NULL) closedir(dir);
+      dir = NULL;
+    };
+    virtual const char *name(void) { return base_name(path); };
+    virtual bool isDirectory(void) { return true; };
+    virtual File openNextFile(void) {
+      struct dirent *e;
+      while ((dir != NULL) && ((e = readdir(dir)) != NULL)) {
+        if ((strcmp(e->d_name, ".") == 0) || (strcmp(e->d_name, "..") == 0)) continue;
+        std::string p = (path == "/") ? path + e->d_name : path + "/" + e->d_name;
+        return fs->open(p.c_str());
+      }
+      return File();
+    };
+    virtual void rewindDirectory(void) { if (dir != NULL) rewinddir(dir); };
+
+  private:
+    PosixFS *fs;
+    DIR *dir;
+    std::string path;
+};
+
+File PosixFS::open(const char *path, uint8_t mode)
+{
+  std::string p = clean_path(path);
+  std::string hp = host_path(p.c_str());
+  DIR *dir = opendir(hp.c_str());
+  if (dir != NULL) return File(new PosixDir(this, dir, p));
+  int fd = ::open(hp.c_str(), (mode == FILE_WRITE) ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+  if (fd < 0) return File();
+  if (mode == FILE_WRITE) lseek(fd, 0, SEEK_END);
+  return File(new PosixFile(fd, p));
+}
+
+bool PosixFS::exists(const char *path)
+{
+  struct stat st;
+  return stat(host_path(path).c_str(), &st) == 0;
+}
+
+bool PosixFS::remove(const char *path)
+{
+  return unlink(host_path(path).c_str()) == 0;
+}
+
+bool PosixFS::rename(const char *from, const char *to)
+{
+  return ::rename(host_path(from).c_str(), host_path(to).c_str()) == 0;
+}
+
+bool PosixFS::mkdir(const char *path)
+{
+  return ::mkdir(host_path(path).c_str(), 0755) == 0;
+}
+
+bool PosixFS::rmdir(const char *path)
+{
+  return ::rmdir(host_path(path).c_str()) == 0;
+}
+
+uint64_t PosixFS::totalSize(void)
+{
+  struct statvfs st;
+  if (statvfs(root.c_str(), &st) != 0) return 0;
+  return (uint64_t)st.f_blocks * st.f_frsize;
+}
+
+uint64_t PosixFS::usedSize(void)
+{
+  struct statvfs st;
+  if (statvfs(root.c_str(), &st) != 0) return 0;
+  return (uint64_t)(st.f_blocks - st.f_bavail) * st.f_frsize;
+}
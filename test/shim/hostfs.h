@@ -0,0 +1,94 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * File systems for the host build.
+ *
+ * MemFS keeps files in a map the test can look at and change directly:
+ *
+ *    MemFS fs;
+ *    fs.files["/a.bin"] = data;
+ *
+ * File names are full pathnames. Directories are in dirs, "/" always
+ * exists. A file must not be removed while it is open. totalSize() is
+ * total and writes fail once fail_after bytes have been written, to test
+ * full and failing media. open_files counts files opened and not closed,
+ * a handle dropped without close() stays counted.
+ *
+ * PosixFS maps the pathnames to a directory of the host file system.
+ */
+
+#ifndef _HOSTFS_H_
+#define _HOSTFS_H_
+
+#include <FS.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class MemFS : public FS {
+  public:
+    MemFS() {
+      dirs.insert("/");
+    };
+
+    virtual File open(const char *path, uint8_t mode=FILE_READ);
+    virtual bool exists(const char *path);
+    virtual bool remove(const char *path);
+    virtual bool rename(const char *from, const char *to);
+    virtual bool mkdir(const char *path);
+    virtual bool rmdir(const char *path);
+    virtual uint64_t totalSize(void) { return total; };
+    virtual uint64_t usedSize(void);
+
+    std::map<std::string, std::vector<uint8_t> > files;
+    std::set<std::string> dirs;
+    uint64_t total = 1 << 30;
+    uint64_t fail_after = ~(uint64_t)0;
+    uint64_t written = 0;
+    uint32_t writes = 0;     // File::write calls
+    int open_files = 0;
+};
+
+class PosixFS : public FS {
+  public:
+    PosixFS(const char *root) : root(root) {};
+
+    virtual File open(const char *path, uint8_t mode=FILE_READ);
+    virtual bool exists(const char *path);
+    virtual bool remove(const char *path);
+    virtual bool rename(const char *from, const char *to);
+    virtual bool mkdir(const char *path);
+    virtual bool rmdir(const char *path);
+    virtual uint64_t totalSize(void);
+    virtual uint64_t usedSize(void);
+
+  private:
+    std::string root;
+
+    std::string host_path(const char *path) { return root + "/" + path; };
+};
+
+#endif /* _HOSTFS_H_ */
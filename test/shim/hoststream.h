@@ -0,0 +1,108 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Streams for the host build.
+ *
+ * PipeStream is one end of an in-memory serial link made of two Pipes, one
+ * for each direction:
+ *
+ *    Pipe a, b;
+ *    PipeStream sender(&b, &a), receiver(&a, &b);
+ *
+ * FdStream is a POSIX file descriptor, for example a pty or a tty, read
+ * without blocking and buffered. StringStream collects what is printed to it.
+ */
+
+#ifndef _HOSTSTREAM_H_
+#define _HOSTSTREAM_H_
+
+#include <Arduino.h>
+#include <deque>
+#include <string>
+
+struct Pipe {
+  std::deque<uint8_t> q;
+};
+
+class PipeStream : public Stream {
+  public:
+    PipeStream(Pipe *in, Pipe *out) : in(in), out(out) {};
+
+    virtual size_t write(uint8_t c) {
+      out->q.push_back(c);
+      return 1;
+    };
+    virtual size_t write(const uint8_t *buf, size_t len) {
+      out->q.insert(out->q.end(), buf, buf + len);
+      return len;
+    };
+    using Print::write;
+    virtual int available(void) { return in->q.size(); };
+    virtual int read(void) {
+      if (in->q.empty()) return -1;
+      int c = in->q.front();
+      in->q.pop_front();
+      return c;
+    };
+    virtual int peek(void) { return (in->q.empty()) ? -1 : in->q.front(); };
+
+    Pipe *in;
+    Pipe *out;
+};
+
+class FdStream : public Stream {
+  public:
+    FdStream(int fd) : fd(fd) {};
+
+    virtual size_t write(uint8_t c) { return write(&c, 1); };
+    virtual size_t write(const uint8_t *buf, size_t len);
+    using Print::write;
+    virtual int available(void);
+    virtual int read(void);
+    virtual int peek(void);
+
+  private:
+    int fd;
+    // Read ahead so a byte costs no system call.
+    uint8_t rx_buf[256];
+    uint16_t rx_head = 0;
+    uint16_t rx_len = 0;
+};
+
+class StringStream : public Stream {
+  public:
+    virtual size_t write(uint8_t c) {
+      text += (char)c;
+      return 1;
+    };
+    using Print::write;
+    virtual int available(void) { return 0; };
+    virtual int read(void) { return -1; };
+    virtual int peek(void) { return -1; };
+
+    std::string text;
+};
+
+#endif /* _HOSTSTREAM_H_ */
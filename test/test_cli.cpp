@@ -0,0 +1,138 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * SerialFileBrowser commands on a MemFS, typed into a pipe.
+ */
+
+#include <SerialFileBrowser.h>
+#include <hostfs.h>
+#include <hoststream.h>
+#include "check.h"
+#include "refsender.h"
+
+static Pipe in, out;
+static PipeStream port(&in, &out);
+static MemFS fs;
+static SerialFileBrowser cli(port, fs);
+
+static void type(const char *keys)
+{
+  in.q.insert(in.q.end(), keys, keys + strlen(keys));
+}
+
+// Run the CLI until it has taken all input and return what it printed.
+static std::string run(void)
+{
+  for (int i = 0; (i < 100000) && !in.q.empty(); i++) cli.loop_cli();
+  std::string text(out.q.begin(), out.q.end());
+  out.q.clear();
+  return text;
+}
+
+static bool contains(const std::string &text, const char *what)
+{
+  if (text.find(what) != std::string::npos) return true;
+  printf("<%s> not in <%s>\n", what, text.c_str());
+  return false;
+}
+
+// The pathname rule shared by the CLI and the receivers.
+static void test_pathname(void)
+{
+  char p[12];
+  CHECK_EQ(xy_full_pathname("/logs", "a.txt", p, sizeof(p)), 0);
+  CHECK(strcmp(p, "/logs/a.txt") == 0);
+  CHECK_EQ(xy_full_pathname("/logs/", "a.txt", p, sizeof(p)), 0);
+  CHECK(strcmp(p, "/logs/a.txt") == 0);
+  CHECK_EQ(xy_full_pathname("", "a.txt", p, sizeof(p)), 0);
+  CHECK(strcmp(p, "/a.txt") == 0);
+  CHECK_EQ(xy_full_pathname("/logs", "/b/c.txt", p, sizeof(p)), 0);
+  CHECK(strcmp(p, "/b/c.txt") == 0);
+  CHECK_EQ(xy_full_pathname("/logs", "ab.txt", p, sizeof(p)), -2);
+  CHECK_EQ(xy_full_pathname("/", "/0123456789a", p, sizeof(p)), -2);
+  CHECK_EQ(xy_full_pathname("/", "", p, sizeof(p)), -1);
+}
+
+int main()
+{
+  test_pathname();
+  cli.setup_cli();
+  CHECK(run() == "$ ");
+  type("mkdir logs\rcd logs\rpwd\r");
+  CHECK(contains(run(), "/logs\r\n"));
+  type("capture check.txt\r123456789\x04");
+  run();
+  CHECK(fs.files["/logs/check.txt"] == std::vector<uint8_t>({'1','2','3','4','5','6','7','8','9'}));
+  type("cat check.txt\r");
+  CHECK(contains(run(), "123456789"));
+  type("ls\r");
+  CHECK(contains(run(), "check.txt 9\r\n"));
+  type("sum check.txt\r");
+  CHECK(contains(run(), "cbf43926 "
+        "15e2b0d3c33891ebb0f1ef609ec419420c20e320ce94c65fbc8c3312448eb225 "
+        "9 /logs/check.txt\r\n"));
+  type("bogus\r");
+  CHECK(contains(run(), "command not found"));
+  // No trace buffer unless the sketch gives one.
+  type("evdump\r");
+  CHECK(contains(run(), "XYEV 1 0 0\r\nEND\r\n"));
+
+  // rb from the reference sender, then the digest of what came in.
+  static xyevent_t events[64];
+  XYsha256 sha;
+  cli.setEventTrace(events, 64);
+  cli.setSha256(&sha);
+  // No prompt on the line the transfer is about to use.
+  type("rb\r");
+  CHECK(!contains(run(), "$ "));
+  RefSender s(&in, &out);
+  RefFile f;
+  f.name = "up.txt";
+  f.data.assign(9, 0);
+  memcpy(f.data.data(), "123456789", 9);
+  s.files.push_back(f);
+  host_clock_set(0);
+  for (int i = 0; (i < 100000) && (s.state != RefSender::DONE); i++) {
+    s.step();
+    cli.loop_cli();
+    host_clock_advance(1);
+  }
+  CHECK_EQ(s.state, RefSender::DONE);
+  cli.loop_cli();
+  out.q.clear();
+  CHECK(fs.files["/up.txt"] == f.data);
+  type("sum\r");
+  CHECK(contains(run(), "cbf43926 "
+        "15e2b0d3c33891ebb0f1ef609ec419420c20e320ce94c65fbc8c3312448eb225 "
+        "9 (last received)"));
+  type("evdump\r");
+  std::string dump = run();
+  CHECK(contains(dump, "XYEV 1 "));
+  CHECK(dump.find("XYEV 1 0 0") == std::string::npos);
+  type("rm /up.txt\r");
+  run();
+  CHECK(!fs.exists("/up.txt"));
+  return check_report("cli");
+}
@@ -0,0 +1,137 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Several receivers side by side, the way examples/multirx runs them: one
+ * XYmodem object per port, all polled in turn from one loop, all writing
+ * to one file system. Each port is a simulated 115200 baud line with its
+ * own reference sender. Checks that every file arrives intact and that
+ * each port keeps the throughput of a single session. Prints one CSV line
+ * per session count:
+ *
+ *    sessions,port_Bps_min,port_Bps_max,total_Bps,cpu_us_per_kb
+ *
+ * port_Bps is file bytes per simulated second on one port, cpu_us_per_kb
+ * the host CPU time spent in loop() for each KB received.
+ *
+ *    test_concurrent [max sessions]
+ */
+
+#include <xymodem.h>
+#include <hostfs.h>
+#include <hoststream.h>
+#include "check.h"
+#include "refsender.h"
+#include "line.h"
+#include <random>
+#include <time.h>
+
+static const size_t FILE_BYTES = 64 * 1024;
+
+struct Session {
+  Pipe s_out, r_in, r_out, s_in;
+  Line down, up;
+  PipeStream port;
+  RefSender sender;
+  XYmodem rx;
+  std::string dir;
+  uint32_t done_ms;
+
+  Session() : down(&s_out, &r_in), up(&r_out, &s_in), port(&r_in, &r_out),
+    sender(&s_out, &s_in), done_ms(0) {};
+};
+
+static double cpu_s(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Returns the lowest per port throughput.
+static double run(size_t sessions)
+{
+  static std::mt19937 rng(1);
+  MemFS fs;
+  std::vector<Session *> s;
+  for (size_t i = 0; i < sessions; i++) {
+    Session *p = new Session();
+    p->dir = "/port" + std::to_string(i);
+    fs.mkdir(p->dir.c_str());
+    RefFile f;
+    f.name = "fw.bin";
+    for (size_t k = 0; k < FILE_BYTES; k++) f.data.push_back(rng());
+    p->sender.files.push_back(f);
+    s.push_back(p);
+  }
+  host_clock_set(0);
+  for (size_t i = 0; i < sessions; i++) {
+    s[i]->rx.start_rb(s[i]->port, fs, s[i]->dir.c_str(), true, true);
+  }
+  double cpu = 0;
+  size_t active = sessions;
+  for (uint32_t now = 0; (now < 600000) && (active > 0); now++) {
+    host_clock_set(now);
+    for (size_t i = 0; i < sessions; i++) {
+      s[i]->down.tick(now);
+      s[i]->up.tick(now);
+      s[i]->sender.step();
+    }
+    double start = cpu_s();
+    for (size_t i = 0; i < sessions; i++) {
+      if ((s[i]->done_ms == 0) && (s[i]->rx.loop() == 0)) {
+        s[i]->done_ms = now;
+        active--;
+      }
+    }
+    cpu += cpu_s() - start;
+  }
+  double lo = 1e12, hi = 0, total = 0;
+  uint32_t end_ms = 0;
+  for (size_t i = 0; i < sessions; i++) {
+    CHECK(fs.files[s[i]->dir + "/fw.bin"] == s[i]->sender.files[0].data);
+    CHECK(s[i]->done_ms != 0);
+    double bps = (s[i]->done_ms != 0) ? FILE_BYTES * 1000.0 / s[i]->done_ms : 0;
+    lo = min(lo, bps);
+    hi = max(hi, bps);
+    end_ms = max(end_ms, s[i]->done_ms);
+    delete s[i];
+  }
+  total = (end_ms != 0) ? FILE_BYTES * sessions * 1000.0 / end_ms : 0;
+  printf("%u,%.0f,%.0f,%.0f,%.2f\n", (unsigned)sessions, lo, hi, total,
+      cpu * 1e6 * 1024 / (FILE_BYTES * sessions));
+  return lo;
+}
+
+int main(int argc, char **argv)
+{
+  size_t max_sessions = (argc > 1) ? atoi(argv[1]) : 8;
+
+  printf("sessions,port_Bps_min,port_Bps_max,total_Bps,cpu_us_per_kb\n");
+  double single = run(1);
+  for (size_t n = 2; n <= max_sessions; n *= 2) {
+    CHECK(run(n) >= 0.95 * single);
+  }
+  return check_report("concurrent");
+}
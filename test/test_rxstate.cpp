@@ -0,0 +1,443 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Unit tests of the XYmodem state machine, one protocol step at a time.
+ * Receive runs through feed() so every reply can be checked, send through
+ * a pipe. The event trace shows which states were visited and the test
+ * fails unless all of rxmodem_t was.
+ */
+
+#include <xymodem.h>
+#include <hostfs.h>
+#include <hoststream.h>
+#include "check.h"
+#include "refsender.h"
+
+// rxmodem_t, as recorded in XYEV_STATE events.
+enum { IDLE, BLOCKSTART, BLOCKNUM, BLOCKCHECK, DATABLOCK, RESYNC,
+  SENDSTART, SENDBLOCK, SENDEOT, STATES };
+
+typedef std::vector<uint8_t> bytes_t;
+
+static xyevent_t events[256];
+static bool visited[STATES];
+
+static void trace(XYmodem &x)
+{
+  x.setEventTrace(events, 256);
+}
+
+static void note_states(void)
+{
+  for (int i = 0; i < 256; i++) {
+    if ((events[i].type == XYEV_STATE) && (events[i].a < STATES)) {
+      visited[events[i].a] = true;
+    }
+  }
+  memset(events, 0, sizeof(events));
+}
+
+static bytes_t block(uint8_t num, const bytes_t &data, size_t size, bool crc=true)
+{
+  return ref_block(num, data.data(), data.size(), size, crc, (num == 0) ? 0 : 0x1A);
+}
+
+static bytes_t header(const char *name, const char *length)
+{
+  bytes_t d(name, name + strlen(name) + 1);
+  if (length != NULL) d.insert(d.end(), length, length + strlen(length));
+  return block(0, d, 128);
+}
+
+static bytes_t data(size_t len, uint8_t seed)
+{
+  bytes_t d;
+  for (size_t i = 0; i < len; i++) d.push_back((uint8_t)(seed + i * 7));
+  return d;
+}
+
+// Feed bytes one at a time, like a slow UART, and return the replies.
+static bytes_t feed(XYmodem &x, const bytes_t &in)
+{
+  bytes_t out;
+  uint8_t reply[XYmodem::REPLY_MAX];
+  for (size_t i = 0; i < in.size(); i++) {
+    size_t n = x.feed(&in[i], 1, reply, sizeof(reply));
+    out.insert(out.end(), reply, reply + n);
+  }
+  size_t n = x.feed(NULL, 0, reply, sizeof(reply));
+  out.insert(out.end(), reply, reply + n);
+  return out;
+}
+
+static bytes_t reply(uint8_t a, int b=-1)
+{
+  bytes_t r(1, a);
+  if (b >= 0) r.push_back(b);
+  return r;
+}
+
+static void test_start(void)
+{
+  MemFS fs;
+  uint8_t r[XYmodem::REPLY_MAX];
+  XYmodem crc, sum, g;
+
+  CHECK(!crc.active());
+  CHECK_EQ(crc.loop(), IDLE);
+  CHECK_EQ(crc.start_rb(fs, "/", true, true), 0);
+  CHECK(crc.active());
+  CHECK(feed(crc, bytes_t()) == reply('C'));
+  CHECK_EQ(sum.start_rb(fs, "/", false, false), 0);
+  CHECK(feed(sum, bytes_t()) == reply(NAK));
+  CHECK_EQ(g.start_rb(fs, "/", true, false, true), 0);
+  CHECK(feed(g, bytes_t()) == reply('G'));
+  // Replies that do not fit come out of the next call.
+  XYmodem x;
+  x.setWindow(4);
+  x.start_rb(fs, "/", true, true);
+  CHECK_EQ(x.feed(NULL, 0, r, 1), 1);
+  CHECK_EQ(r[0], 'W');
+  CHECK_EQ(x.feed(NULL, 0, r, 1), 1);
+  CHECK_EQ(r[0], '4');
+  // With no room at all the held bytes fill up. The rest are counted.
+  host_clock_set(0);
+  XYmodem y;
+  y.start_rb(fs, "/", true, true);
+  for (int i = 0; i < 12; i++) {
+    CHECK_EQ(y.feed(NULL, 0, r, 0), 0);
+    host_clock_advance(20000);
+  }
+  CHECK(y.getStats().reply_overflows > 0);
+}
+
+static void test_ymodem_file(void)
+{
+  MemFS fs;
+  XYmodem x;
+  XYmodem::hist_t hist;
+  trace(x);
+  x.setHistograms(&hist);
+  host_clock_set(0);
+  x.start_rb(fs, "/", true, true);
+  feed(x, bytes_t());
+  bytes_t d = data(1100, 1);
+  // BLOCKSTART, BLOCKNUM, BLOCKCHECK, DATABLOCK
+  CHECK(feed(x, header("a.bin", "1100")) == reply(ACK, 'C'));
+  CHECK(fs.exists("/a.bin"));
+  CHECK(feed(x, block(1, bytes_t(d.begin(), d.begin() + 1024), 1024)) == reply(ACK));
+  CHECK(feed(x, block(2, bytes_t(d.begin() + 1024, d.end()), 128)) == reply(ACK));
+  CHECK(feed(x, reply(EOT)) == reply(ACK, 'C'));
+  CHECK(fs.files["/a.bin"] == d);
+  CHECK(x.active());
+  // An empty block 0 ends the batch.
+  CHECK(feed(x, header("", NULL)) == reply(ACK));
+  CHECK(!x.active());
+  CHECK_EQ(x.getStats().blocks, 2);
+  CHECK_EQ(x.getStats().files, 1);
+  CHECK_EQ(x.getStats().bytes, 1100);
+  uint32_t gaps = 0, writes = 0;
+  for (int i = 0; i < XYmodem::HIST_BINS; i++) {
+    gaps += hist.interarrival[i];
+    writes += hist.write[i];
+  }
+  CHECK_EQ(gaps, 1u);
+  CHECK_EQ(writes, 2u);
+  note_states();
+}
+
+// Directory and file name longer than the path buffer: cancel.
+static void test_long_path(void)
+{
+  MemFS fs;
+  XYmodem x;
+  std::string dir = "/" + std::string(120, 'd');
+  x.start_rb(fs, dir.c_str(), false, true);
+  feed(x, bytes_t());
+  CHECK(feed(x, header("twenty_chars_long.bin", "10")) == bytes_t({ ACK, CAN, CAN }));
+  CHECK(!x.active());
+  CHECK(fs.files.empty());
+}
+
+// Without the file sink the object is smaller and only takes other sinks.
+static void test_static(void)
+{
+  MemFS fs;
+  StaticXYmodem<128, 32, false> raw;
+  StaticXYmodem<128, 32> files;
+  uint8_t buf[256];
+  XYramSink ram(buf, sizeof(buf));
+  CHECK(sizeof(raw) < sizeof(files));
+  CHECK_EQ(raw.start_rb(fs, "/", false, true), 1);
+  CHECK_EQ(raw.start_rb(ram, false, true), 0);
+  CHECK_EQ(files.start_rb(fs, "/", false, true), 0);
+  CHECK_EQ(raw.footprint(), sizeof(raw));
+  CHECK_EQ(files.footprint(), sizeof(files));
+}
+
+static void test_xmodem_checksum(void)
+{
+  MemFS fs;
+  Pipe in, out;
+  PipeStream port(&in, &out);
+  XYmodem x;
+  trace(x);
+  CHECK_EQ(x.start_rx(port, fs, "x.bin", false, false), 0);
+  CHECK(out.q.size() == 1 && out.q.front() == NAK);
+  out.q.clear();
+  bytes_t d = data(128, 9);
+  bytes_t b = block(1, d, 128, false);
+  in.q.insert(in.q.end(), b.begin(), b.end());
+  in.q.push_back(EOT);
+  CHECK_EQ(x.loop(), IDLE);
+  CHECK(bytes_t(out.q.begin(), out.q.end()) == bytes_t(2, ACK));
+  CHECK(fs.files["/x.bin"] == d);
+  note_states();
+}
+
+// A port that claims 64 KB waiting, like a big USB or socket buffer. The
+// fast path must still read the block.
+class BigStream : public PipeStream {
+  public:
+    BigStream(Pipe *in, Pipe *out) : PipeStream(in, out) {};
+    virtual int available(void) { return (in->q.empty()) ? 0 : 65536; };
+};
+
+static void test_big_available(void)
+{
+  MemFS fs;
+  Pipe in, out;
+  BigStream port(&in, &out);
+  XYmodem x;
+  x.start_rx(port, fs, "x.bin", false, true);
+  bytes_t d = data(128, 4);
+  bytes_t b = block(1, d, 128);
+  in.q.insert(in.q.end(), b.begin(), b.end());
+  in.q.push_back(EOT);
+  CHECK_EQ(x.loop(), IDLE);
+  CHECK(fs.files["/x.bin"] == d);
+}
+
+static void test_timeouts(void)
+{
+  MemFS fs;
+  XYmodem x;
+  trace(x);
+  x.setTimeoutPolicy(1000, 10000, false);
+  host_clock_set(0);
+  x.start_rb(fs, "/", true, true);
+  feed(x, bytes_t());
+  host_clock_advance(2000);
+  CHECK(feed(x, bytes_t()).empty());
+  host_clock_advance(1001);
+  CHECK(feed(x, bytes_t()) == reply('C'));
+  CHECK_EQ(x.getStats().timeouts, 1);
+  // Half a block then silence: NAK after the short timeout.
+  bytes_t b = header("t.bin", "10");
+  CHECK(feed(x, bytes_t(b.begin(), b.begin() + 50)).empty());
+  host_clock_advance(1001);
+  CHECK(feed(x, bytes_t()) == reply('C'));
+  CHECK_EQ(x.getStats().timeouts, 2);
+  CHECK(feed(x, b) == reply(ACK, 'C'));
+  note_states();
+}
+
+static void test_errors(void)
+{
+  MemFS fs;
+  XYmodem x;
+  trace(x);
+  x.setTimeoutPolicy(1000, 10000, false);
+  host_clock_set(0);
+  x.start_rb(fs, "/", false, true);
+  feed(x, bytes_t());
+  feed(x, header("e.bin", "256"));
+  bytes_t d = data(256, 3);
+  bytes_t b1 = block(1, bytes_t(d.begin(), d.begin() + 128), 128);
+  bytes_t b2 = block(2, bytes_t(d.begin() + 128, d.end()), 128);
+
+  // Bad CRC
+  bytes_t bad = b1;
+  bad[60] ^= 1;
+  CHECK(feed(x, bad) == reply(NAK));
+  CHECK_EQ(x.getStats().bad_checks, 1);
+
+  // Bad block number complement: RESYNC, NAK once the line is quiet.
+  bytes_t hdr = b1;
+  hdr[2] = 0;
+  CHECK(feed(x, bytes_t(hdr.begin(), hdr.begin() + 3)).empty());
+  host_clock_advance(51);
+  CHECK(feed(x, bytes_t()) == reply(NAK));
+
+  // Garbage in front of a good block is skipped.
+  bytes_t noisy(5, 0x55);
+  noisy.insert(noisy.end(), b1.begin(), b1.end());
+  CHECK(feed(x, noisy) == reply(ACK));
+
+  // Repeat of the last block: ACK, counted as a duplicate.
+  CHECK(feed(x, b1) == reply(ACK));
+  CHECK_EQ(x.getStats().duplicates, 1);
+
+  // 1K block into a 128 byte receiver: NAK.
+  bytes_t big = block(2, d, 1024);
+  host_clock_advance(1);
+  CHECK(feed(x, bytes_t(big.begin(), big.begin() + 3)).empty());
+  host_clock_advance(51);
+  CHECK(feed(x, bytes_t()) == reply(NAK));
+
+  CHECK(feed(x, b2) == reply(ACK));
+  CHECK(feed(x, reply(EOT)) == reply(ACK, 'C'));
+  CHECK(fs.files["/e.bin"] == d);
+
+  // Out of sequence: cancel.
+  feed(x, header("f.bin", "256"));
+  bytes_t b3 = block(3, d, 128);
+  CHECK(feed(x, bytes_t(b3.begin(), b3.begin() + 3)).empty());
+  host_clock_advance(51);
+  CHECK(feed(x, bytes_t()) == bytes_t(2, CAN));
+  CHECK(!x.active());
+  note_states();
+}
+
+// Block 0 is parsed inside the block only, also when fed in one piece.
+static void test_block0_bounds(void)
+{
+  MemFS fs;
+  XYmodem x;
+  uint8_t r[XYmodem::REPLY_MAX];
+  x.start_rb(fs, "/", false, true);
+  feed(x, bytes_t());
+  // Name and length fill the block exactly, the CRC follows.
+  bytes_t d(124, 'n');
+  d.push_back('\0');
+  d.push_back('5');
+  d.push_back('1');
+  d.push_back('2');
+  bytes_t b0 = block(0, d, 128);
+  size_t n = x.feed(b0.data(), b0.size(), r, sizeof(r));
+  CHECK(bytes_t(r, r + n) == reply(ACK, 'C'));
+  std::string name = "/" + std::string(124, 'n');
+  CHECK(fs.exists(name.c_str()));
+  bytes_t rest;
+  for (uint8_t i = 1; i <= 4; i++) {
+    bytes_t b = block(i, data(128, i), 128);
+    rest.insert(rest.end(), b.begin(), b.end());
+  }
+  rest.push_back(EOT);
+  feed(x, rest);
+  CHECK_EQ(fs.files[name].size(), 512u);
+
+  // A name with no end: cancel, no file.
+  MemFS fs2;
+  XYmodem y;
+  y.start_rb(fs2, "/", false, true);
+  feed(y, bytes_t());
+  b0 = block(0, bytes_t(128, 'x'), 128);
+  n = y.feed(b0.data(), b0.size(), r, sizeof(r));
+  CHECK(bytes_t(r, r + n) == bytes_t({ ACK, CAN, CAN }));
+  CHECK(!y.active());
+  CHECK(fs2.files.empty());
+}
+
+static void test_streaming_error(void)
+{
+  MemFS fs;
+  XYmodem x;
+  x.start_rb(fs, "/", true, true, true);
+  CHECK(feed(x, bytes_t()) == reply('G'));
+  // No ACKs in YMODEM-G, 'G' asks for the data.
+  CHECK(feed(x, header("g.bin", "100")) == reply('G'));
+  bytes_t b = block(1, data(100, 5), 128);
+  b[10] ^= 1;
+  CHECK(feed(x, b) == bytes_t(2, CAN));
+  CHECK(!x.active());
+}
+
+static void test_send(void)
+{
+  MemFS fs;
+  Pipe a, b;
+  PipeStream port(&a, &b);
+  XYmodem x;
+  trace(x);
+  fs.files["/s.bin"] = data(200, 4);
+  host_clock_set(0);
+  CHECK_EQ(x.start_sx(port, fs, "/s.bin", false), 0);
+  CHECK_EQ(x.loop(), SENDSTART);
+  a.q.push_back('C');
+  CHECK_EQ(x.loop(), SENDBLOCK);
+  bytes_t d = data(200, 4);
+  bytes_t b1 = block(1, bytes_t(d.begin(), d.begin() + 128), 128);
+  CHECK(bytes_t(b.q.begin(), b.q.end()) == b1);
+  b.q.clear();
+  // NAK sends it again.
+  a.q.push_back(NAK);
+  CHECK_EQ(x.loop(), SENDBLOCK);
+  CHECK(bytes_t(b.q.begin(), b.q.end()) == b1);
+  b.q.clear();
+  a.q.push_back(ACK);
+  CHECK_EQ(x.loop(), SENDBLOCK);
+  CHECK(bytes_t(b.q.begin(), b.q.end()) == block(2, bytes_t(d.begin() + 128, d.end()), 128));
+  b.q.clear();
+  a.q.push_back(ACK);
+  CHECK_EQ(x.loop(), SENDEOT);
+  CHECK(bytes_t(b.q.begin(), b.q.end()) == reply(EOT));
+  b.q.clear();
+  // Lost EOT: sent again after the timeout.
+  host_clock_advance(6001);
+  CHECK_EQ(x.loop(), SENDEOT);
+  CHECK(bytes_t(b.q.begin(), b.q.end()) == reply(EOT));
+  a.q.push_back(ACK);
+  CHECK_EQ(x.loop(), IDLE);
+  note_states();
+
+  // Two CANs cancel.
+  x.start_sx(port, fs, "/s.bin", false);
+  a.q.push_back('C');
+  x.loop();
+  a.q.push_back(CAN);
+  a.q.push_back(CAN);
+  CHECK_EQ(x.loop(), IDLE);
+}
+
+int main()
+{
+  test_start();
+  test_ymodem_file();
+  test_xmodem_checksum();
+  test_big_available();
+  test_timeouts();
+  test_errors();
+  test_block0_bounds();
+  test_long_path();
+  test_static();
+  test_streaming_error();
+  test_send();
+  for (int s = 0; s < STATES; s++) {
+    if (!visited[s]) printf("state %d not visited\n", s);
+    CHECK(visited[s]);
+  }
+  return check_report("rxstate");
+}
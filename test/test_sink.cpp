@@ -0,0 +1,258 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+/*
+ * The sinks on their own, without a transfer, and their failure paths.
+ */
+
+#include <xymodem.h>
+#include <xyblock.h>
+#include <xylz.h>
+#include <hostfs.h>
+#include <hoststream.h>
+#include "check.h"
+#include "refsender.h"
+
+// NOR flash in RAM whose erase or program can be made to fail.
+class FailDevice : public XYramDevice {
+  public:
+    FailDevice(uint8_t *mem, uint32_t size, uint32_t erase_size) :
+      XYramDevice(mem, size, erase_size) {};
+
+    int erase_fails_at = -1;    // erase call number that fails
+    int program_fails_at = -1;  // program call number that fails
+    int erase_calls = 0;
+    int program_calls = 0;
+
+    virtual bool erase(uint32_t addr) {
+      if (erase_calls++ == erase_fails_at) return false;
+      return XYramDevice::erase(addr);
+    };
+    virtual bool program(uint32_t addr, const uint8_t *data, size_t len) {
+      if (program_calls++ == program_fails_at) return false;
+      return XYramDevice::program(addr, data, len);
+    };
+};
+
+static uint8_t flash[16384];
+static uint8_t data[4096];
+
+static void test_partition_ok(void)
+{
+  FailDevice dev(flash, sizeof(flash), 1024);
+  XYpartitionSink slot(dev, 4096, 8192);
+  uint8_t back[4096];
+
+  for (size_t i = 0; i < sizeof(data); i++) data[i] = i * 7;
+  CHECK(slot.begin_file("/fw.bin", 3000));
+  for (size_t i = 0; i < 3000; i += 128) {
+    size_t n = min((size_t)128, 3000 - i);
+    CHECK_EQ(slot.write(data + i, n), n);
+  }
+  CHECK_EQ(slot.read(0, back, sizeof(back)), 3000);
+  CHECK(memcmp(back, data, 3000) == 0);
+  CHECK_EQ(slot.read(3000, back, 10), 0);
+  slot.end_file();
+  CHECK_EQ(slot.errors(), 0u);
+  CHECK_EQ(dev.overwrites, 0u);
+  CHECK_EQ(dev.erases, 3u);
+  CHECK(!slot.begin_file("/big.bin", 8193));
+}
+
+// A failed program or erase is a short write, at once and afterwards.
+static void test_partition_fail(void)
+{
+  FailDevice dev(flash, sizeof(flash), 1024);
+  XYpartitionSink slot(dev, 0, 8192);
+
+  dev.program_fails_at = 2;
+  CHECK(slot.begin_file("/fw.bin", 4096));
+  CHECK_EQ(slot.write(data, 128), 128u);
+  CHECK_EQ(slot.write(data, 128), 128u);
+  CHECK_EQ(slot.write(data, 128), 0u);
+  CHECK_EQ(slot.write(data, 128), 0u);
+  CHECK_EQ(slot.written(), 256u);
+  CHECK_EQ(slot.errors(), 1u);
+
+  // The erase for the second erase block runs ahead, after a write.
+  FailDevice dev2(flash, sizeof(flash), 1024);
+  XYpartitionSink slot2(dev2, 0, 8192);
+  dev2.erase_fails_at = 1;
+  CHECK(slot2.begin_file("/fw.bin", 4096));
+  CHECK_EQ(slot2.write(data, 1024), 1024u);
+  CHECK_EQ(slot2.write(data, 1024), 0u);
+  CHECK_EQ(dev2.overwrites, 0u);
+
+  // The first erase, started by begin_file().
+  FailDevice dev3(flash, sizeof(flash), 1024);
+  XYpartitionSink slot3(dev3, 0, 8192, 1);
+  dev3.erase_fails_at = 0;
+  CHECK(slot3.begin_file("/fw.bin", XYsink::UNKNOWN_LENGTH));
+  CHECK_EQ(slot3.write(data, 512), 0u);
+  CHECK_EQ(dev3.program_calls, 0);
+}
+
+// The old file counts as free space and stays when the new one is refused.
+static void test_file_replace(void)
+{
+  MemFS fs;
+  XYfileSink sink(fs);
+
+  fs.total = 10000;
+  fs.files["/a"] = std::vector<uint8_t>(6000, 'a');
+  CHECK(!sink.begin_file("/b", 5000));
+  CHECK(!fs.exists("/b"));
+  CHECK(!sink.begin_file("/a", 10001));
+  CHECK_EQ(fs.files["/a"].size(), 6000u);
+  CHECK(sink.begin_file("/a", 9000));
+  CHECK_EQ(sink.write(data, 100), 100u);
+  uint8_t back[100];
+  CHECK(sink.readable());
+  CHECK_EQ(sink.read(0, back, sizeof(back)), 100);
+  CHECK(memcmp(back, data, sizeof(back)) == 0);
+  CHECK_EQ(sink.read(100, back, sizeof(back)), 0);
+  CHECK_EQ(sink.read(101, back, sizeof(back)), -1);
+  sink.end_file();
+  CHECK_EQ(fs.files["/a"].size(), 100u);
+
+  sink.setPreallocate([](File &, uint32_t) { return false; });
+  CHECK(!sink.begin_file("/c", 10));
+  CHECK(!fs.exists("/c"));
+}
+
+// The xylz.py format, greedy matches found by brute force.
+static std::vector<uint8_t> lz_compress(const std::vector<uint8_t> &in)
+{
+  std::vector<uint8_t> out = { 'X', 'L', 'Z', 1 };
+  for (int i = 0; i < 4; i++) out.push_back((uint8_t)(in.size() >> (8 * i)));
+  size_t flag_at = 0;
+  int items = 8;
+  for (size_t pos = 0; pos < in.size(); ) {
+    if (items == 8) {
+      flag_at = out.size();
+      out.push_back(0);
+      items = 0;
+    }
+    size_t best = 0, dist = 0;
+    for (size_t d = 1; (d <= 1024) && (d <= pos); d++) {
+      size_t n = 0;
+      while ((n < 66) && (pos + n < in.size()) && (in[pos + n] == in[pos + n - d])) n++;
+      if (n > best) {
+        best = n;
+        dist = d;
+      }
+    }
+    if (best >= 3) {
+      uint16_t code = (uint16_t)(((dist - 1) << 6) | (best - 3));
+      out[flag_at] |= 1 << items;
+      out.push_back(code >> 8);
+      out.push_back(code & 0xFF);
+      pos += best;
+    }
+    else {
+      out.push_back(in[pos++]);
+    }
+    items++;
+  }
+  return out;
+}
+
+// A cut short .lz file is bad and its output removed.
+static void test_lz_truncated(void)
+{
+  MemFS fs;
+  XYfileSink files(fs);
+  XYlzSink unlz(files);
+  std::vector<uint8_t> text;
+  for (int i = 0; i < 3000; i++) text.push_back("config line "[i % 12] + (i / 700));
+  std::vector<uint8_t> z = lz_compress(text);
+  CHECK(z.size() < text.size() / 2);
+
+  CHECK(unlz.begin_file("/c.txt.lz", z.size()));
+  CHECK_EQ(unlz.write(z.data(), z.size()), z.size());
+  CHECK(unlz.end_file());
+  CHECK(fs.files["/c.txt"] == text);
+
+  CHECK(unlz.begin_file("/d.txt.lz", z.size()));
+  CHECK_EQ(unlz.write(z.data(), z.size() - 5), z.size() - 5);
+  CHECK(!unlz.end_file());
+  unlz.cancel_file("/d.txt.lz");
+  CHECK(!fs.exists("/d.txt"));
+  CHECK_EQ(unlz.errors(), 1u);
+
+  // Through a transfer: the EOT gets CAN instead of ACK.
+  Pipe a, b;
+  PipeStream port(&a, &b);
+  XYmodem x;
+  RefSender s(&a, &b);
+  RefFile f;
+  f.name = "e.txt.lz";
+  f.data.assign(z.begin(), z.begin() + z.size() / 2);
+  s.files.push_back(f);
+  host_clock_set(0);
+  x.start_rb(port, unlz, true, true);
+  for (int i = 0; (i < 100000) && (x.active() || !b.q.empty()); i++) {
+    s.step();
+    x.loop();
+    host_clock_advance(1);
+  }
+  CHECK(!x.active());
+  CHECK_EQ(s.state, RefSender::CANCELLED);
+  CHECK(!fs.exists("/e.txt"));
+}
+
+// A match reaching back before the first byte fails the write.
+static void test_lz_bad_distance(void)
+{
+  MemFS fs;
+  XYfileSink files(fs);
+  XYlzSink unlz(files);
+  // 2 literals then a match 3 back: flags 0b100.
+  std::vector<uint8_t> z = { 'X', 'L', 'Z', 1, 5, 0, 0, 0, 0x04, 'a', 'b',
+    (2 << 6) >> 8, (2 << 6) & 0xFF };
+  CHECK(unlz.begin_file("/f.txt.lz", z.size()));
+  CHECK(unlz.write(z.data(), z.size()) < z.size());
+  CHECK(!unlz.end_file());
+  unlz.cancel_file("/f.txt.lz");
+  CHECK(!fs.exists("/f.txt"));
+  CHECK_EQ(unlz.errors(), 1u);
+
+  // 2 back is fine: "ab" then "aba".
+  z[12] = (1 << 6) & 0xFF;
+  CHECK(unlz.begin_file("/g.txt.lz", z.size()));
+  CHECK_EQ(unlz.write(z.data(), z.size()), z.size());
+  CHECK(unlz.end_file());
+  CHECK(fs.files["/g.txt"] == std::vector<uint8_t>({'a','b','a','b','a'}));
+}
+
+int main()
+{
+  test_partition_ok();
+  test_partition_fail();
+  test_file_replace();
+  test_lz_truncated();
+  test_lz_bad_distance();
+  return check_report("sink");
+}
@@ -0,0 +1,411 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * End to end transfers on the host: the reference sender against loop()
+ * and feed(), and the XYmodem sender against the XYmodem receiver, with
+ * and without write-behind, write coalescing and windowed mode, on clean
+ * and corrupting links.
+ */
+
+#include <xymodem.h>
+#include <hostfs.h>
+#include <hoststream.h>
+#include "check.h"
+#include "refsender.h"
+#include <random>
+
+static std::mt19937 rng(1);
+
+static RefFile make_file(const char *name, size_t len)
+{
+  RefFile f;
+  f.name = name;
+  for (size_t i = 0; i < len; i++) f.data.push_back(rng());
+  return f;
+}
+
+typedef struct {
+  bool ymodem;
+  bool use_1k;
+  bool crc;
+  bool streaming;
+  int corrupt_every;
+  bool pool;
+  bool coalesce;
+} options_t;
+
+static void configure(XYmodem &x, const options_t &o)
+{
+  static uint8_t pool[4 * 1032];
+  static uint8_t co[512];
+  if (o.pool) x.setWriteBehind(pool, sizeof(pool));
+  if (o.coalesce) x.setWriteCoalescing(co, sizeof(co));
+}
+
+static bool received(MemFS &fs, const std::vector<RefFile> &files, bool ymodem)
+{
+  bool good = true;
+  for (size_t i = 0; i < files.size(); i++) {
+    std::vector<uint8_t> &got = fs.files["/" + files[i].name];
+    std::vector<uint8_t> want = files[i].data;
+    if (!ymodem) {
+      // XMODEM pads to whole blocks.
+      want.resize((want.size() + 127) / 128 * 128, 0x1A);
+      if (got.size() > want.size()) want.resize(got.size(), 0x1A);
+    }
+    if (got != want) {
+      printf("%s: got %u bytes, want %u\n", files[i].name.c_str(),
+          (unsigned)got.size(), (unsigned)want.size());
+      good = false;
+    }
+  }
+  return good;
+}
+
+// Reference sender to loop() through a pipe.
+static bool run_loop(const options_t &o, const std::vector<RefFile> &files)
+{
+  Pipe a, b;
+  PipeStream port(&a, &b);
+  MemFS fs;
+  XYmodem x;
+  RefSender s(&a, &b);
+  s.files = files;
+  s.ymodem = o.ymodem;
+  s.use_1k = o.use_1k;
+  s.corrupt_every = o.corrupt_every;
+  configure(x, o);
+  host_clock_set(0);
+  if (o.ymodem) x.start_rb(port, fs, o.use_1k, o.crc, o.streaming);
+  else x.start_rx(port, fs, files[0].name.c_str(), o.use_1k, o.crc);
+  for (int i = 0; (i < 1000000) && (x.active() || !b.q.empty()); i++) {
+    s.step();
+    x.loop();
+    host_clock_advance(1);
+  }
+  return !x.active() && received(fs, files, o.ymodem);
+}
+
+// Reference sender to feed() in random sized pieces.
+static bool run_feed(const options_t &o, const std::vector<RefFile> &files, int max_chunk)
+{
+  Pipe a, b;
+  MemFS fs;
+  XYmodem x;
+  RefSender s(&a, &b);
+  s.files = files;
+  s.use_1k = o.use_1k;
+  s.corrupt_every = o.corrupt_every;
+  configure(x, o);
+  host_clock_set(0);
+  x.start_rb(fs, "/", o.use_1k, o.crc, o.streaming);
+  uint8_t chunk[4096];
+  uint8_t reply[XYmodem::REPLY_MAX];
+  for (int i = 0; (i < 1000000) && x.active(); i++) {
+    s.step();
+    size_t n = min(a.q.size(), (size_t)(1 + rng() % max_chunk));
+    for (size_t k = 0; k < n; k++) {
+      chunk[k] = a.q.front();
+      a.q.pop_front();
+    }
+    size_t r = x.feed(chunk, n, reply, sizeof(reply));
+    b.q.insert(b.q.end(), reply, reply + r);
+    host_clock_advance(1);
+  }
+  return !x.active() && received(fs, files, true);
+}
+
+static void test_reference_sender(void)
+{
+  std::vector<RefFile> batch;
+  batch.push_back(make_file("a.bin", 5000));
+  batch.push_back(make_file("b.bin", 1024));
+  batch.push_back(make_file("c.bin", 1));
+  batch.push_back(make_file("empty.bin", 0));
+  std::vector<RefFile> one(1, make_file("x.bin", 20000));
+
+  for (int mode = 0; mode < 4; mode++) {
+    options_t o = { true, true, true, false, 0, (mode & 1) != 0, (mode & 2) != 0 };
+    CHECK(run_loop(o, batch));
+    CHECK(run_feed(o, batch, 1));
+    CHECK(run_feed(o, batch, 2000));
+    o.corrupt_every = 3;
+    CHECK(run_loop(o, one));
+    CHECK(run_feed(o, one, 7));
+    o.corrupt_every = 0;
+    o.streaming = true;
+    CHECK(run_loop(o, batch));
+    CHECK(run_feed(o, batch, 200));
+    options_t o128 = { true, false, true, false, 0, o.pool, o.coalesce };
+    CHECK(run_loop(o128, batch));
+    options_t sum = { true, true, false, false, 0, o.pool, o.coalesce };
+    CHECK(run_loop(sum, one));
+    options_t xm = { false, true, true, false, 0, o.pool, o.coalesce };
+    CHECK(run_loop(xm, one));
+    options_t xsum = { false, false, false, false, 5, o.pool, o.coalesce };
+    CHECK(run_loop(xsum, one));
+  }
+}
+
+// XYmodem sender to XYmodem receiver, bit flips on the data direction.
+// window sets windowed mode on both ends, pool write-behind on the receiver.
+static void test_xymodem_pair(bool ymodem, bool use_1k, bool crc, int flip_one_in,
+    uint8_t window=0, bool pool=false)
+{
+  Pipe s2r, r2s;
+  PipeStream sport(&r2s, &s2r), rport(&s2r, &r2s);
+  MemFS sfs, rfs;
+  const size_t sizes[] = { 0, 1, 127, 128, 129, 1023, 1024, 1025, 5000, 100000 };
+  std::vector<std::string> names;
+  const char *list[16];
+  sfs.mkdir("/logs");
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    names.push_back("f" + std::to_string(i) + ".bin");
+    sfs.files["/logs/" + names[i]] = make_file("", sizes[i]).data;
+  }
+  for (size_t i = 0; i < names.size(); i++) list[i] = names[i].c_str();
+  XYmodem tx, rx;
+  XYsha256 sha;
+  uint8_t verify_buf[300];
+  static uint8_t pool_buf[8 * 1032];
+  tx.setWindow(window);
+  rx.setWindow(window);
+  if (pool) rx.setWriteBehind(pool_buf, sizeof(pool_buf));
+  rx.setSha256(&sha);
+  rx.setVerify(verify_buf, sizeof(verify_buf));
+  host_clock_set(0);
+  if (ymodem) {
+    tx.start_sb(sport, sfs, "/logs", list, names.size(), use_1k);
+    rx.start_rb(rport, rfs, true, crc);
+  }
+  else {
+    tx.start_sx(sport, sfs, "/logs/f8.bin", use_1k);
+    rx.start_rx(rport, rfs, "/x.bin", true, crc);
+  }
+  int t = 1, r = 1;
+  for (int i = 0; (i < 2000000) && (t || r); i++) {
+    t = tx.loop();
+    if ((flip_one_in != 0) && !s2r.q.empty() && (rng() % flip_one_in == 0)) {
+      s2r.q[rng() % s2r.q.size()] ^= 0x20;
+    }
+    r = rx.loop();
+    if (i % 4 == 0) host_clock_advance(1);
+  }
+  CHECK_EQ(t, 0);
+  CHECK_EQ(r, 0);
+  if (ymodem) {
+    for (size_t i = 0; i < names.size(); i++) {
+      CHECK(rfs.files["/" + names[i]] == sfs.files["/logs/" + names[i]]);
+    }
+    CHECK_EQ(rx.getStats().verified, names.size());
+    // The digest of the last file as it was written.
+    std::vector<uint8_t> &last = sfs.files["/logs/" + names.back()];
+    uint8_t got[XYsha256::DIGEST_SIZE], want[XYsha256::DIGEST_SIZE];
+    XYsha256 ref;
+    ref.update(last.data(), last.size());
+    ref.finish(want);
+    CHECK(rx.fileSha256(got));
+    CHECK(memcmp(got, want, sizeof(want)) == 0);
+  }
+  else {
+    std::vector<uint8_t> &got = rfs.files["/x.bin"];
+    std::vector<uint8_t> &sent = sfs.files["/logs/f8.bin"];
+    CHECK_EQ(got.size() % 128, 0);
+    CHECK(got.size() >= sent.size());
+    CHECK(std::equal(sent.begin(), sent.end(), got.begin()));
+  }
+}
+
+// Counts the blocks the sender writes, the most written without reading a
+// reply in between, and flips a bit in block number corrupt.
+class TapStream : public PipeStream {
+  public:
+    TapStream(Pipe *in, Pipe *out) : PipeStream(in, out) {};
+
+    using PipeStream::write;
+    virtual size_t write(const uint8_t *buf, size_t len) {
+      if (len < 3 + 128 + 1) return PipeStream::write(buf, len);
+      std::vector<uint8_t> b(buf, buf + len);
+      if (++blocks == corrupt) b[len / 2] ^= 0x20;
+      if (++burst > max_burst) max_burst = burst;
+      return PipeStream::write(b.data(), len);
+    };
+    virtual int read(void) {
+      burst = 0;
+      return PipeStream::read();
+    };
+
+    int corrupt = 0;
+    int blocks = 0;
+    int burst = 0;
+    int max_burst = 0;
+};
+
+// Windowed YMODEM of 16 1K blocks with block 3 corrupted. Returns the
+// blocks sent, including the two block 0s.
+static int window_run(uint8_t tx_window, uint8_t rx_window, bool pool,
+    int *max_burst)
+{
+  Pipe s2r, r2s;
+  TapStream sport(&r2s, &s2r);
+  PipeStream rport(&s2r, &r2s);
+  MemFS sfs, rfs;
+  static uint8_t pool_buf[8 * 1032];
+  const char *list[] = { "w.bin" };
+  sfs.files["/w.bin"] = make_file("", 16 * 1024).data;
+  XYmodem tx, rx;
+  tx.setWindow(tx_window);
+  rx.setWindow(rx_window);
+  if (pool) rx.setWriteBehind(pool_buf, sizeof(pool_buf));
+  sport.corrupt = 4;
+  host_clock_set(0);
+  tx.start_sb(sport, sfs, "/", list, 1, true);
+  rx.start_rb(rport, rfs, true, true);
+  int t = 1, r = 1;
+  for (int i = 0; (i < 200000) && (t || r); i++) {
+    t = tx.loop();
+    r = rx.loop();
+    if (i % 4 == 0) host_clock_advance(1);
+  }
+  CHECK_EQ(t, 0);
+  CHECK_EQ(r, 0);
+  CHECK(rfs.files["/w.bin"] == sfs.files["/w.bin"]);
+  CHECK_EQ(rx.getStats().naks, 1);
+  *max_burst = sport.max_burst;
+  return sport.blocks;
+}
+
+static void test_window(void)
+{
+  int burst;
+  // Write-behind keeps the blocks after the bad one, only it goes again.
+  CHECK_EQ(window_run(4, 4, true, &burst), 19);
+  CHECK_EQ(burst, 4);
+  // Without it they are dropped and the sender goes back.
+  CHECK(window_run(4, 4, false, &burst) > 19);
+  CHECK_EQ(burst, 4);
+  // The smaller window of the two.
+  window_run(4, 2, true, &burst);
+  CHECK_EQ(burst, 2);
+  // Either end without a window: classic, one block at a time.
+  CHECK_EQ(window_run(4, 0, true, &burst), 19);
+  CHECK_EQ(burst, 1);
+  CHECK_EQ(window_run(0, 4, true, &burst), 19);
+  CHECK_EQ(burst, 1);
+}
+
+// External drain as a task on the same core: it runs between loop() calls,
+// slower than YMODEM-G fills the pool, and from yield(). The receiver must
+// yield while it waits for a free slot, or this never ends.
+static XYmodem *yield_rx;
+static uint32_t yields;
+
+static void drain_on_yield(void)
+{
+  yields++;
+  yield_rx->drain();
+}
+
+static void test_external_drain(void)
+{
+  Pipe a, b;
+  PipeStream port(&a, &b);
+  MemFS fs;
+  XYmodem x;
+  static uint8_t pool[2 * 1032];
+  std::vector<RefFile> files(1, make_file("g.bin", 30000));
+  RefSender s(&a, &b);
+  s.files = files;
+  s.use_1k = true;
+  yield_rx = &x;
+  yields = 0;
+  host_yield_hook(drain_on_yield);
+  x.setWriteBehind(pool, sizeof(pool), true);
+  host_clock_set(0);
+  x.start_rb(port, fs, true, true, true);
+  for (int i = 0; (i < 100000) && (x.active() || !b.q.empty()); i++) {
+    s.step();
+    x.loop();
+    if (i % 50 == 0) x.drain();
+    host_clock_advance(1);
+  }
+  host_yield_hook(NULL);
+  CHECK(!x.active());
+  CHECK(received(fs, files, true));
+  CHECK(yields > 0);
+}
+
+/*
+ * A file name that fits in MaxPath but not in block 0 cancels the send
+ * instead of writing past the block buffer. One that fits goes in a 1K
+ * block 0.
+ */
+static void test_long_header(void)
+{
+  Pipe s2r, r2s;
+  PipeStream sport(&r2s, &s2r);
+  MemFS sfs;
+  StaticXYmodem<1024, 1100> tx;
+  std::string longname(1030, 'n');
+  std::string name(200, 'm');
+  const char *list[] = { longname.c_str(), name.c_str() };
+  sfs.files["/" + longname] = make_file("", 100).data;
+  sfs.files["/" + name] = make_file("", 100).data;
+
+  host_clock_set(0);
+  CHECK_EQ(tx.start_sb(sport, sfs, "/", list, 1, true), 0);
+  r2s.q.push_back('C');
+  tx.loop();
+  CHECK_EQ(tx.loop(), 0);
+  CHECK(!s2r.q.empty() && (s2r.q.back() == 0x18));
+
+  s2r.q.clear();
+  CHECK_EQ(tx.start_sb(sport, sfs, "/", list + 1, 1, true), 0);
+  r2s.q.push_back('C');
+  tx.loop();
+  CHECK(tx.loop() != 0);
+  CHECK(!s2r.q.empty() && (s2r.q.front() == 0x02));
+  CHECK(std::string(s2r.q.begin() + 3, s2r.q.begin() + 3 + 200) == name);
+}
+
+int main()
+{
+  test_reference_sender();
+  test_external_drain();
+  test_xymodem_pair(true, true, true, 0);
+  test_xymodem_pair(true, false, true, 0);
+  test_xymodem_pair(true, true, false, 0);
+  test_xymodem_pair(false, true, true, 0);
+  test_xymodem_pair(true, true, true, 20);
+  test_xymodem_pair(false, false, true, 20);
+  test_window();
+  test_xymodem_pair(true, true, true, 0, 4, false);
+  test_xymodem_pair(true, true, true, 20, 4, false);
+  test_xymodem_pair(true, true, true, 20, 4, true);
+  test_xymodem_pair(true, false, true, 20, 9, true);
+  test_xymodem_pair(false, true, true, 20, 4, true);
+  test_long_header();
+  return check_report("transfer");
+}
@@ -0,0 +1,260 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+/*
+ * ZMODEM receive against a scripted sender: skip, replace or resume an existing
+ * file, and cancel on a short write.
+ */
+
+#include <zmodem.h>
+#include <hostfs.h>
+#include <hoststream.h>
+#include "check.h"
+#include "refsender.h"
+
+typedef std::vector<uint8_t> bytes_t;
+
+enum { ZRINIT = 1, ZFILE = 4, ZSKIP = 5, ZFIN = 8, ZRPOS = 9, ZDATA = 10,
+  ZEOF = 11 };
+static const uint8_t ZDLE = 0x18;
+static const uint8_t ZCRESUM = 3;
+
+// Hex header, p[0] first on the line (ZF3 or the low byte of a position).
+static void hex_header(Pipe &out, uint8_t type, const uint8_t p[4])
+{
+  static const char hexdigit[] = "0123456789abcdef";
+  uint8_t raw[7] = { type, p[0], p[1], p[2], p[3] };
+  uint16_t crc = ref_crc16(raw, 5);
+  raw[5] = crc >> 8;
+  raw[6] = crc & 0xFF;
+  const char start[] = { '*', '*', ZDLE, 'B' };
+  out.q.insert(out.q.end(), start, start + 4);
+  for (int i = 0; i < 7; i++) {
+    out.q.push_back(hexdigit[raw[i] >> 4]);
+    out.q.push_back(hexdigit[raw[i] & 0x0F]);
+  }
+  out.q.push_back('\r');
+  out.q.push_back('\n');
+}
+
+static void zdle_put(Pipe &out, uint8_t c)
+{
+  uint8_t low = c & 0x7F;
+  if ((c == ZDLE) || (low == 0x10) || (low == 0x11) || (low == 0x13)) {
+    out.q.push_back(ZDLE);
+    out.q.push_back(c ^ 0x40);
+  }
+  else {
+    out.q.push_back(c);
+  }
+}
+
+// Binary header with CRC-16, for the headers data subpackets follow.
+static void bin_header(Pipe &out, uint8_t type, const uint8_t p[4])
+{
+  uint8_t raw[5] = { type, p[0], p[1], p[2], p[3] };
+  uint16_t crc = ref_crc16(raw, 5);
+  out.q.push_back('*');
+  out.q.push_back(ZDLE);
+  out.q.push_back('A');
+  for (int i = 0; i < 5; i++) zdle_put(out, raw[i]);
+  zdle_put(out, crc >> 8);
+  zdle_put(out, crc & 0xFF);
+}
+
+static void pos_header(Pipe &out, uint8_t type, uint32_t pos, bool bin=false)
+{
+  uint8_t p[4] = { (uint8_t)pos, (uint8_t)(pos >> 8), (uint8_t)(pos >> 16),
+    (uint8_t)(pos >> 24) };
+  if (bin) bin_header(out, type, p);
+  else hex_header(out, type, p);
+}
+
+// Data subpacket with CRC-16 ending in end (ZCRCE 'h', ZCRCW 'k' ...).
+static void subpacket(Pipe &out, const uint8_t *data, size_t len, uint8_t end)
+{
+  bytes_t crcd(data, data + len);
+  crcd.push_back(end);
+  uint16_t crc = ref_crc16(crcd.data(), crcd.size());
+  for (size_t i = 0; i < len; i++) zdle_put(out, data[i]);
+  out.q.push_back(ZDLE);
+  out.q.push_back(end);
+  zdle_put(out, crc >> 8);
+  zdle_put(out, crc & 0xFF);
+}
+
+// Last hex header the receiver sent: type, and position in pos.
+static int last_header(Pipe &in, uint32_t *pos)
+{
+  std::string s(in.q.begin(), in.q.end());
+  in.q.clear();
+  size_t at = s.rfind("**\x18" "B");
+  if ((at == std::string::npos) || (s.size() < at + 4 + 14)) return -1;
+  uint8_t h[7];
+  for (int i = 0; i < 7; i++) {
+    h[i] = strtoul(s.substr(at + 4 + 2 * i, 2).c_str(), NULL, 16);
+  }
+  if (pos != NULL) {
+    *pos = h[1] | ((uint32_t)h[2] << 8) | ((uint32_t)h[3] << 16) |
+      ((uint32_t)h[4] << 24);
+  }
+  return h[0];
+}
+
+static void run(Zmodem &rz, Pipe &out)
+{
+  for (int i = 0; (i < 1000) && !out.q.empty(); i++) {
+    rz.loop();
+    host_clock_advance(1);
+  }
+  rz.loop();
+}
+
+/*
+ * Send file as name with ZF0 flags. Returns the position the receiver asked
+ * for, -1 if it skipped the file or -2 for any other answer.
+ */
+static long offer(Zmodem &rz, Pipe &s2r, Pipe &r2s, const char *name,
+    const bytes_t &file, uint8_t zf0)
+{
+  uint8_t flags[4] = { 0, 0, 0, zf0 };
+  std::string info = std::string(name) + '\0' + std::to_string(file.size()) + " 0 0";
+  bin_header(s2r, ZFILE, flags);
+  subpacket(s2r, (const uint8_t *)info.data(), info.size(), 'k');
+  run(rz, s2r);
+  uint32_t pos;
+  int type = last_header(r2s, &pos);
+  if (type == ZSKIP) return -1;
+  if (type != ZRPOS) return -2;
+  return pos;
+}
+
+// Data from pos to the end in 1 KB subpackets, then ZEOF.
+static void send_from(Zmodem &rz, Pipe &s2r, const bytes_t &file, uint32_t pos)
+{
+  if (pos < file.size()) pos_header(s2r, ZDATA, pos, true);
+  while (pos < file.size()) {
+    size_t n = min((size_t)1024, file.size() - pos);
+    subpacket(s2r, &file[pos], n, (pos + n < file.size()) ? 'i' : 'h');
+    pos += n;
+  }
+  pos_header(s2r, ZEOF, file.size());
+  run(rz, s2r);
+}
+
+static bytes_t make(size_t len, uint8_t seed)
+{
+  bytes_t d;
+  for (size_t i = 0; i < len; i++) d.push_back((uint8_t)(seed + i * 13 + (i >> 7)));
+  return d;
+}
+
+static void test_replace_and_resume(void)
+{
+  Pipe s2r, r2s;
+  PipeStream port(&s2r, &r2s);
+  MemFS fs;
+  Zmodem rz;
+  bytes_t file = make(5000, 1);
+
+  host_clock_set(0);
+  CHECK_EQ(rz.start_rz(port, fs, "/"), 0);
+  CHECK_EQ(last_header(r2s, NULL), ZRINIT);
+
+  // New file.
+  CHECK_EQ(offer(rz, s2r, r2s, "a.bin", file, 0), 0);
+  send_from(rz, s2r, file, 0);
+  CHECK_EQ(last_header(r2s, NULL), ZRINIT);
+  CHECK(fs.files["/a.bin"] == file);
+
+  // Same name and length: already here, skipped with or without sz -r.
+  bytes_t other = make(5000, 2);
+  CHECK_EQ(offer(rz, s2r, r2s, "a.bin", other, 0), -1);
+  CHECK_EQ(offer(rz, s2r, r2s, "a.bin", other, ZCRESUM), -1);
+  CHECK(fs.files["/a.bin"] == file);
+
+  // Other length, no recovery asked: replaced.
+  bytes_t longer = make(6000, 2);
+  CHECK_EQ(offer(rz, s2r, r2s, "a.bin", longer, 0), 0);
+  send_from(rz, s2r, longer, 0);
+  CHECK(fs.files["/a.bin"] == longer);
+
+  // Shorter file there, no recovery asked: start over.
+  fs.files["/b.bin"] = bytes_t(file.begin(), file.begin() + 2000);
+  CHECK_EQ(offer(rz, s2r, r2s, "b.bin", other, 0), 0);
+  send_from(rz, s2r, other, 0);
+  CHECK(fs.files["/b.bin"] == other);
+
+  // Shorter file there and sz -r: carry on from its end.
+  fs.files["/c.bin"] = bytes_t(file.begin(), file.begin() + 2000);
+  CHECK_EQ(offer(rz, s2r, r2s, "c.bin", file, ZCRESUM), 2000);
+  send_from(rz, s2r, file, 2000);
+  CHECK(fs.files["/c.bin"] == file);
+
+  // Longer file there and sz -r: start over.
+  bytes_t shorter = make(3000, 4);
+  CHECK_EQ(offer(rz, s2r, r2s, "c.bin", shorter, ZCRESUM), 0);
+
+  // The sender offers it again before any data. The first open is closed.
+  CHECK_EQ(offer(rz, s2r, r2s, "c.bin", shorter, ZCRESUM), 0);
+  CHECK_EQ(fs.open_files, 1);
+  send_from(rz, s2r, shorter, 0);
+  CHECK_EQ(fs.open_files, 0);
+  CHECK(fs.files["/c.bin"] == shorter);
+
+  pos_header(s2r, ZFIN, 0);
+  run(rz, s2r);
+  CHECK_EQ(last_header(r2s, NULL), ZFIN);
+  s2r.q.push_back('O');
+  s2r.q.push_back('O');
+  run(rz, s2r);
+  CHECK_EQ(rz.loop(), 0);
+}
+
+static void test_short_write(void)
+{
+  Pipe s2r, r2s;
+  PipeStream port(&s2r, &r2s);
+  MemFS fs;
+  Zmodem rz;
+  bytes_t file = make(5000, 3);
+
+  host_clock_set(0);
+  fs.fail_after = 1500;
+  rz.start_rz(port, fs, "/");
+  last_header(r2s, NULL);
+  CHECK_EQ(offer(rz, s2r, r2s, "d.bin", file, 0), 0);
+  send_from(rz, s2r, file, 0);
+  std::string sent(r2s.q.begin(), r2s.q.end());
+  CHECK(sent.find(std::string(8, ZDLE)) != std::string::npos);
+  CHECK_EQ(rz.loop(), 0);
+}
+
+int main()
+{
+  test_replace_and_resume();
+  test_short_write();
+  return check_report("zmodem");
+}
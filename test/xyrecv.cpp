@@ -0,0 +1,222 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Host XMODEM/YMODEM/ZMODEM receiver for bench.sh and for trying senders
+ * without a board. Runs the same engines as the sketches, with the real
+ * clock, on a pty or a tty, and writes the files under dir.
+ *
+ *    xyrecv [-x name | -z] [-c] [-g] [-wN] [-p] dir [tty]
+ *
+ * Without tty it opens a pty and prints "pty <slave path>" on the first
+ * line so a sender such as lrzsz sb, sx or sz can be started on it. The
+ * options are those of the CLI where there is one:
+ *
+ *    -x name  XMODEM receive into name (start_rx), for sx. Default is a
+ *             YMODEM batch (start_rb), for sb.
+ *    -z       ZMODEM receive (Zmodem::start_rz), for sz. The other options
+ *             do not apply.
+ *    -c       ask for 8 bit checksums instead of CRC-16.
+ *    -g       YMODEM-G streaming, as rb -g.
+ *    -wN      windowed mode with up to N blocks in flight, as rb -wN.
+ *    -p       write-behind through an 8 KB block pool.
+ *
+ * At the end of the session it prints one line:
+ *
+ *    bytes=<n> files=<n> seconds=<s> cpu_us=<n> naks=<n> timeouts=<n>
+ *
+ * cpu_us is the user plus system time of the receiver, seconds the time
+ * from the first block accepted to the end of the session. Exits 1 if a
+ * write failed. Zmodem keeps no counters, so with -z bytes and files are
+ * what ended up in dir, seconds runs from start_rz() and naks and timeouts
+ * are left out.
+ */
+
+#include <xymodem.h>
+#include <zmodem.h>
+#include <hostfs.h>
+#include <hoststream.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+static uint64_t cpu_us(void)
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return (uint64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 +
+    ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+// Regular files in dir and their total size.
+static void dir_totals(const char *dir, unsigned *files, unsigned long *bytes)
+{
+  *files = 0;
+  *bytes = 0;
+  DIR *d = opendir(dir);
+  if (d == NULL) return;
+  struct dirent *e;
+  while ((e = readdir(d)) != NULL) {
+    std::string p = std::string(dir) + "/" + e->d_name;
+    struct stat st;
+    if ((stat(p.c_str(), &st) == 0) && S_ISREG(st.st_mode)) {
+      (*files)++;
+      *bytes += st.st_size;
+    }
+  }
+  closedir(d);
+}
+
+static int set_raw(int fd)
+{
+  struct termios t;
+  if (tcgetattr(fd, &t) != 0) return -1;
+  cfmakeraw(&t);
+  return tcsetattr(fd, TCSANOW, &t);
+}
+
+int main(int argc, char **argv)
+{
+  const char *xmodem_name = NULL;
+  bool zmodem = false;
+  bool crc = true;
+  bool streaming = false;
+  uint8_t window = 0;
+  bool write_behind = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "x:zcgw:p")) != -1) {
+    if (opt == 'x') xmodem_name = optarg;
+    else if (opt == 'z') zmodem = true;
+    else if (opt == 'c') crc = false;
+    else if (opt == 'g') streaming = true;
+    else if (opt == 'w') window = atoi(optarg);
+    else if (opt == 'p') write_behind = true;
+    else optind = argc;
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "usage: xyrecv [-x name | -z] [-c] [-g] [-wN] [-p] dir [tty]\n");
+    return 2;
+  }
+  const char *dir = argv[optind];
+
+  int fd;
+  int slave = -1;
+  if (optind + 1 < argc) {
+    fd = open(argv[optind + 1], O_RDWR | O_NOCTTY);
+    if ((fd < 0) || (set_raw(fd) != 0)) {
+      perror(argv[optind + 1]);
+      return 2;
+    }
+  }
+  else {
+    fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((fd < 0) || (grantpt(fd) != 0) || (unlockpt(fd) != 0)) {
+      perror("pty");
+      return 2;
+    }
+    // Keep the slave open so reads do not fail between senders.
+    slave = open(ptsname(fd), O_RDWR | O_NOCTTY);
+    if ((slave < 0) || (set_raw(slave) != 0)) {
+      perror(ptsname(fd));
+      return 2;
+    }
+    printf("pty %s\n", ptsname(fd));
+    fflush(stdout);
+  }
+
+  host_clock_real(true);
+  PosixFS fs(dir);
+  FdStream port(fd);
+  struct pollfd pfd = { fd, POLLIN, 0 };
+  int ret = 0;
+  if (zmodem) {
+    Zmodem rz;
+    if (rz.start_rz(port, fs, "/") != 0) {
+      fprintf(stderr, "start failed\n");
+      return 2;
+    }
+    uint32_t first_ms = millis();
+    while (rz.loop() != 0) {
+      if (port.available() == 0) poll(&pfd, 1, 10);
+    }
+    unsigned files;
+    unsigned long bytes;
+    dir_totals(dir, &files, &bytes);
+    printf("bytes=%lu files=%u seconds=%.3f cpu_us=%llu\n", bytes, files,
+        (millis() - first_ms) / 1000.0, (unsigned long long)cpu_us());
+  }
+  else {
+    XYmodem rx;
+    static uint8_t pool_mem[8 * 1024];
+    if (write_behind) rx.setWriteBehind(pool_mem, sizeof(pool_mem));
+    rx.setWindow(window);
+    int err = (xmodem_name != NULL) ?
+      rx.start_rx(port, fs, xmodem_name, true, crc) :
+      rx.start_rb(port, fs, "/", true, crc, streaming);
+    if (err != 0) {
+      fprintf(stderr, "start failed\n");
+      return 2;
+    }
+
+    uint32_t first_ms = 0;
+    while (rx.loop() != 0) {
+      if ((first_ms == 0) && (rx.getStats().blocks != 0)) first_ms = millis();
+      // Sleep until bytes arrive so the CPU time is the engine's alone.
+      // Come back sooner while write-behind still has blocks queued.
+      if (port.available() == 0) poll(&pfd, 1, (rx.pending() != 0) ? 1 : 10);
+    }
+
+    const XYmodem::stats_t &st = rx.getStats();
+    uint32_t ms = (first_ms != 0) ? millis() - first_ms : 0;
+    printf("bytes=%u files=%u seconds=%.3f cpu_us=%llu naks=%u timeouts=%u\n",
+        st.bytes, st.files, ms / 1000.0, (unsigned long long)cpu_us(),
+        st.naks, st.timeouts);
+    if (st.write_errors != 0) ret = 1;
+  }
+  if (slave >= 0) {
+    // Closing the pty drops what the sender has not read yet, which may be
+    // the last ACK. Give it a second to take it. The bytes just written
+    // may not have reached the slave yet, so wait for it to be empty
+    // twice in a row.
+    int empty = 0;
+    for (int i = 0; (i < 100) && (empty < 2); i++) {
+      usleep(10000);
+      int n = 0;
+      if ((ioctl(slave, FIONREAD, &n) != 0) || (n == 0)) empty++;
+      else empty = 0;
+    }
+    close(slave);
+  }
+  close(fd);
+  return ret;
+}
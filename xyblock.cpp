@@ -0,0 +1,136 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <Arduino.h>
+#include <xyblock.h>
+
+bool XYpartitionSink::begin_file(const char *name, uint32_t length)
+{
+  uint32_t esize = dev->eraseSize();
+
+  (void)name;
+  pos = 0;
+  erased = 0;
+  errs = 0;
+  if (length == UNKNOWN_LENGTH) {
+    erase_end = this->length;
+  }
+  else if (length > this->length) {
+    return false;
+  }
+  else {
+    erase_end = (length + esize - 1) / esize * esize;
+  }
+  // The first erase runs while the receiver asks for the data.
+  erase_ahead();
+  return true;
+}
+
+/*
+ * Start the next erase if the device is idle and the data is within ahead
+ * erase blocks of the end of the erased part.
+ */
+void XYpartitionSink::erase_ahead(void)
+{
+  uint32_t esize = dev->eraseSize();
+
+  if ((erased >= erase_end) || dev->busy()) return;
+  if (erased - pos >= (uint32_t)ahead * esize) return;
+  if (!dev->erase(offset + erased)) errs++;
+  erased += esize;
+}
+
+/*
+ * Returns 0 if an erase or program failed, now or in an earlier call, so
+ * XYmodem cancels instead of going on with a bad image.
+ */
+size_t XYpartitionSink::write(const uint8_t *data, size_t len)
+{
+  uint32_t esize = dev->eraseSize();
+
+  if (errs != 0) return 0;
+  if (len > length - pos) len = length - pos;
+  if (erase_end < pos + len) {
+    // XMODEM pads past the length, or the data ran past it.
+    erase_end = min(length, (pos + len + esize - 1) / esize * esize);
+  }
+  // Usually the erase finished while the block came in.
+  while (erased < pos + len) {
+    wait();
+    if (!dev->erase(offset + erased)) {
+      errs++;
+      return 0;
+    }
+    erased += esize;
+  }
+  wait();
+  if (!dev->program(offset + pos, data, len)) {
+    errs++;
+    return 0;
+  }
+  pos += len;
+  erase_ahead();
+  return len;
+}
+
+bool XYpartitionSink::end_file(void)
+{
+  wait();
+  return errs == 0;
+}
+
+int XYpartitionSink::read(uint32_t at, uint8_t *data, size_t len)
+{
+  if (at >= pos) return 0;
+  if (len > pos - at) len = pos - at;
+  wait();
+  return dev->read(offset + at, data, len) ? len : -1;
+}
+
+bool XYramDevice::erase(uint32_t addr)
+{
+  if ((addr % erase_size) || (addr + erase_size > size)) return false;
+  memset(mem + addr, 0xFF, erase_size);
+  erases++;
+  busy_left = busy_polls;
+  return true;
+}
+
+bool XYramDevice::program(uint32_t addr, const uint8_t *data, size_t len)
+{
+  if ((addr > size) || (len > size - addr) || (busy_left != 0)) return false;
+  for (size_t i = 0; i < len; i++) {
+    if (mem[addr + i] != 0xFF) overwrites++;
+    mem[addr + i] &= data[i];
+  }
+  return true;
+}
+
+bool XYramDevice::read(uint32_t addr, uint8_t *data, size_t len)
+{
+  if ((addr > size) || (len > size - addr)) return false;
+  memcpy(data, mem + addr, len);
+  return true;
+}
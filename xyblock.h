@@ -0,0 +1,143 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef _XYBLOCK_H_
+#define _XYBLOCK_H_
+
+#include "xysink.h"
+
+/*
+ * Raw flash or other block device, for receiving firmware images straight
+ * into an update partition instead of through a FAT file.
+ *
+ * erase() starts erasing the erase block at addr and may return before it
+ * is done, like the sector erase command of SPI NOR flash. busy() is true
+ * until it is. program() writes any length at any address to erased
+ * memory, splitting it into pages if the device needs that. It is only
+ * called when busy() is false.
+ */
+class XYblockDevice {
+  public:
+    virtual ~XYblockDevice() {};
+
+    virtual uint32_t eraseSize(void) = 0;
+    virtual bool erase(uint32_t addr) = 0;
+    virtual bool busy(void) { return false; };
+    virtual bool program(uint32_t addr, const uint8_t *data, size_t len) = 0;
+    virtual bool read(uint32_t addr, uint8_t *data, size_t len) = 0;
+};
+
+/*
+ * A region of a block device, offset and length, both multiples of the
+ * erase size. Each file is written from the start of the region. A file
+ * with a known length that does not fit is refused.
+ *
+ * Erase ahead. Erase blocks are erased one at a time just before the data
+ * reaches them, started right after a write so the erase runs while the
+ * next block comes over the line. Only the erase blocks the file needs are
+ * erased when YMODEM gives its length. ahead is how many erase blocks to
+ * keep erased in front of the data.
+ *
+ * A failed erase or program makes write() return 0, which cancels the
+ * transfer. errors() counts the failures.
+ */
+class XYpartitionSink : public XYsink {
+  public:
+    XYpartitionSink(XYblockDevice &dev, uint32_t offset, uint32_t length, uint8_t ahead=1) {
+      this->dev = &dev;
+      this->offset = offset;
+      this->length = length;
+      this->ahead = (ahead != 0) ? ahead : 1;
+    };
+
+    // Bytes written of the last file.
+    uint32_t written(void) { return pos; };
+    // Erase or program failures in the last file.
+    uint32_t errors(void) { return errs; };
+
+    virtual bool begin_file(const char *name, uint32_t length);
+    virtual size_t write(const uint8_t *data, size_t len);
+    virtual bool end_file(void);
+    virtual bool readable(void) { return true; };
+    virtual int read(uint32_t at, uint8_t *data, size_t len);
+
+  private:
+    XYblockDevice *dev;
+    uint32_t offset;
+    uint32_t length;
+    uint8_t ahead;
+    uint32_t pos = 0;         // next byte of the region to program
+    uint32_t erased = 0;      // region bytes erased or being erased
+    uint32_t erase_end = 0;   // region bytes the file needs erased
+    uint32_t errs = 0;
+
+    void erase_ahead(void);
+    void wait(void) {
+      while (dev->busy()) {
+        yield();
+      }
+    };
+};
+
+/*
+ * RAM pretending to be NOR flash, to run the partition sink on a host or a
+ * board without the flash chip. Erased bytes are 0xFF and programming can
+ * only clear bits. Programming bytes that were not erased is counted in
+ * overwrites. setEraseBusy() makes busy() report true for a number of
+ * calls after each erase.
+ */
+class XYramDevice : public XYblockDevice {
+  public:
+    XYramDevice(uint8_t *mem, uint32_t size, uint32_t erase_size) {
+      this->mem = mem;
+      this->size = size;
+      this->erase_size = erase_size;
+    };
+
+    void setEraseBusy(uint16_t polls) {
+      this->busy_polls = polls;
+    };
+    uint32_t erases = 0;
+    uint32_t overwrites = 0;
+
+    virtual uint32_t eraseSize(void) { return erase_size; };
+    virtual bool erase(uint32_t addr);
+    virtual bool busy(void) {
+      if (busy_left == 0) return false;
+      busy_left--;
+      return true;
+    };
+    virtual bool program(uint32_t addr, const uint8_t *data, size_t len);
+    virtual bool read(uint32_t addr, uint8_t *data, size_t len);
+
+  private:
+    uint8_t *mem;
+    uint32_t size;
+    uint32_t erase_size;
+    uint16_t busy_polls = 0;
+    uint16_t busy_left = 0;
+};
+
+#endif /* _XYBLOCK_H_ */
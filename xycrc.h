@@ -0,0 +1,229 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _XYCRC_H_
+#define _XYCRC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * CRC-16/XMODEM (poly 0x1021, init 0, MSB first) engines.
+ *
+ * All variants share the same interface:
+ *
+ *    crc = XYcrc16Xxx::update(crc, buf, len);
+ *
+ * and produce identical results. They only trade flash for speed.
+ *
+ *    XYcrc16Bitwise   no table, 8 shift/xor per byte
+ *    XYcrc16Nibble    32 byte table, 2 lookups per byte (RAM/flash starved parts)
+ *    XYcrc16Table     512 byte table, 1 lookup per byte
+ *    XYcrc16Slice4    2 KB of tables, 4 bytes per step (32-bit MCUs)
+ *    XYcrc16Slice8    4 KB of tables, 8 bytes per step (32-bit MCUs)
+ *
+ * The tables are generated at compile time and are const so they stay in
+ * flash on ARM. XYcrc16 is the variant used by XYmodem. Select it by defining
+ * XYMODEM_CRC16 to one of the XYMODEM_CRC16_* values below. The default is
+ * slice-by-4 on ARM and the single table everywhere else.
+ *
+ * XYcrc32 is the table driven CRC-32 used by ZMODEM.
+ */
+
+#define XYMODEM_CRC16_BITWISE 0
+#define XYMODEM_CRC16_NIBBLE  1
+#define XYMODEM_CRC16_TABLE   2
+#define XYMODEM_CRC16_SLICE4  3
+#define XYMODEM_CRC16_SLICE8  4
+
+#ifndef XYMODEM_CRC16
+#if defined(__arm__)
+#define XYMODEM_CRC16 XYMODEM_CRC16_SLICE4
+#else
+#define XYMODEM_CRC16 XYMODEM_CRC16_TABLE
+#endif
+#endif
+
+namespace xycrc_detail {
+
+// C++11 constexpr functions must be a single return statement so the table
+// generators below are written recursively.
+
+// Shift 16-bit crc left n bits through the polynomial.
+constexpr uint16_t shift(uint16_t crc, int n)
+{
+  return (n == 0) ? crc :
+    shift((crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1), n - 1);
+}
+
+// Entry i of slice table k: crc of byte i followed by k zero bytes.
+constexpr uint16_t slice(int i, int k)
+{
+  return (k == 0) ? shift((uint16_t)(i << 8), 8) :
+    (uint16_t)((slice(i, k - 1) << 8) ^ shift((uint16_t)(slice(i, k - 1) & 0xFF00), 8));
+}
+
+template<size_t... I> struct seq {};
+template<size_t N, size_t... I> struct make_seq : make_seq<N - 1, N - 1, I...> {};
+template<size_t... I> struct make_seq<0, I...> { typedef seq<I...> type; };
+
+// Slice table K: 256 entries.
+template<int K, typename S = typename make_seq<256>::type> struct table;
+template<int K, size_t... I> struct table<K, seq<I...> > {
+  static constexpr uint16_t t[sizeof...(I)] = { slice(I, K)... };
+};
+template<int K, size_t... I>
+constexpr uint16_t table<K, seq<I...> >::t[sizeof...(I)];
+
+// CRC-32 (reflected poly 0xEDB88320) table entry.
+constexpr uint32_t shift32(uint32_t crc, int n)
+{
+  return (n == 0) ? crc :
+    shift32((crc & 1) ? (crc >> 1) ^ 0xEDB88320UL : crc >> 1, n - 1);
+}
+
+template<typename S = typename make_seq<256>::type> struct table32;
+template<size_t... I> struct table32<seq<I...> > {
+  static constexpr uint32_t t[sizeof...(I)] = { shift32(I, 8)... };
+};
+template<size_t... I>
+constexpr uint32_t table32<seq<I...> >::t[sizeof...(I)];
+
+template<typename S = make_seq<16>::type> struct nibbles;
+template<size_t... I> struct nibbles<seq<I...> > {
+  static constexpr uint16_t t[sizeof...(I)] = { shift((uint16_t)(I << 12), 4)... };
+};
+template<size_t... I>
+constexpr uint16_t nibbles<seq<I...> >::t[sizeof...(I)];
+
+} // namespace xycrc_detail
+
+struct XYcrc16Bitwise {
+  static uint16_t update(uint16_t crc, const uint8_t *buf, size_t len)
+  {
+    while (len--) {
+      crc ^= (uint16_t)*buf++ << 8;
+      for (int count = 0; count < 8; count++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+      }
+    }
+    return crc;
+  }
+};
+
+struct XYcrc16Nibble {
+  static uint16_t update(uint16_t crc, const uint8_t *buf, size_t len)
+  {
+    const uint16_t *t = xycrc_detail::nibbles<>::t;
+    while (len--) {
+      uint8_t c = *buf++;
+      crc = (crc << 4) ^ t[(crc >> 12) ^ (c >> 4)];
+      crc = (crc << 4) ^ t[(crc >> 12) ^ (c & 0x0F)];
+    }
+    return crc;
+  }
+};
+
+struct XYcrc16Table {
+  static uint16_t update(uint16_t crc, const uint8_t *buf, size_t len)
+  {
+    const uint16_t *t = xycrc_detail::table<0>::t;
+    while (len--) {
+      crc = (crc << 8) ^ t[(crc >> 8) ^ *buf++];
+    }
+    return crc;
+  }
+};
+
+struct XYcrc16Slice4 {
+  static uint16_t update(uint16_t crc, const uint8_t *buf, size_t len)
+  {
+    using namespace xycrc_detail;
+    const uint16_t *t = table<0>::t;
+    while (len >= 4) {
+      crc ^= ((uint16_t)buf[0] << 8) | buf[1];
+      crc = table<3>::t[crc >> 8] ^ table<2>::t[crc & 0xFF] ^
+            table<1>::t[buf[2]] ^ t[buf[3]];
+      buf += 4;
+      len -= 4;
+    }
+    while (len--) {
+      crc = (crc << 8) ^ t[(crc >> 8) ^ *buf++];
+    }
+    return crc;
+  }
+};
+
+struct XYcrc16Slice8 {
+  static uint16_t update(uint16_t crc, const uint8_t *buf, size_t len)
+  {
+    using namespace xycrc_detail;
+    const uint16_t *t = table<0>::t;
+    while (len >= 8) {
+      crc ^= ((uint16_t)buf[0] << 8) | buf[1];
+      crc = table<7>::t[crc >> 8] ^ table<6>::t[crc & 0xFF] ^
+            table<5>::t[buf[2]] ^ table<4>::t[buf[3]] ^
+            table<3>::t[buf[4]] ^ table<2>::t[buf[5]] ^
+            table<1>::t[buf[6]] ^ t[buf[7]];
+      buf += 8;
+      len -= 8;
+    }
+    while (len--) {
+      crc = (crc << 8) ^ t[(crc >> 8) ^ *buf++];
+    }
+    return crc;
+  }
+};
+
+/*
+ * CRC-32 as used by ZMODEM, zip and Ethernet. Same chaining convention as
+ * zlib crc32(): start with 0 and feed the result of one call into the next.
+ */
+struct XYcrc32 {
+  static uint32_t update(uint32_t crc, const uint8_t *buf, size_t len)
+  {
+    const uint32_t *t = xycrc_detail::table32<>::t;
+    crc = ~crc;
+    while (len--) {
+      crc = (crc >> 8) ^ t[(crc ^ *buf++) & 0xFF];
+    }
+    return ~crc;
+  }
+};
+
+#if XYMODEM_CRC16 == XYMODEM_CRC16_BITWISE
+typedef XYcrc16Bitwise XYcrc16;
+#elif XYMODEM_CRC16 == XYMODEM_CRC16_NIBBLE
+typedef XYcrc16Nibble XYcrc16;
+#elif XYMODEM_CRC16 == XYMODEM_CRC16_TABLE
+typedef XYcrc16Table XYcrc16;
+#elif XYMODEM_CRC16 == XYMODEM_CRC16_SLICE4
+typedef XYcrc16Slice4 XYcrc16;
+#elif XYMODEM_CRC16 == XYMODEM_CRC16_SLICE8
+typedef XYcrc16Slice8 XYcrc16;
+#else
+#error "XYMODEM_CRC16 must be one of XYMODEM_CRC16_*"
+#endif
+
+#endif /* _XYCRC_H_ */
@@ -0,0 +1,59 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _XYEVENT_H_
+#define _XYEVENT_H_
+
+#include <stdint.h>
+
+/*
+ * Binary event trace. Unlike the debug port trace (xytrace.h) recording an
+ * event is a few stores into a RAM ring buffer, so it does not change the
+ * timing of the transfer. Give XYmodem a buffer with setEventTrace(), run
+ * the transfer, then dump it with dumpEvents() and decode the dump on the
+ * host with xyevent.py.
+ *
+ * Keep the codes in step with xyevent.py.
+ */
+#define XYEV_STATE        1   // a = new state
+#define XYEV_HEADER       2   // a = block, b = block size
+#define XYEV_BLOCK_OK     3   // a = block
+#define XYEV_BLOCK_BAD    4   // a = block
+#define XYEV_SEND         5   // a = ACK/NAK/CAN/C/G/W/SOH/STX/EOT, b = block
+#define XYEV_TIMEOUT      6   // a = state
+#define XYEV_WRITE_START  7   // b = bytes
+#define XYEV_WRITE_END    8   // b = bytes
+#define XYEV_EOT          9
+#define XYEV_RESYNC       10  // a = reply pending
+#define XYEV_FILE_OPEN    11  // b = low 16 bits of the length
+#define XYEV_FILE_CLOSE   12
+
+typedef struct {
+  uint32_t us;      // microsecond clock
+  uint8_t type;     // XYEV_*
+  uint8_t a;
+  uint16_t b;
+} xyevent_t;
+
+#endif /* _XYEVENT_H_ */
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+# Decode an XYmodem event trace dump (evdump command or dumpEvents()) into a
+# timeline. Reads the terminal log from a file or stdin, other lines around
+# the dump are ignored.
+#
+#    ./xyevent.py capture.log
+#
+# Columns: time since the first event in ms, time since the previous event
+# in ms, event.
+import sys
+
+STATES = ["IDLE", "BLOCKSTART", "BLOCKNUM", "BLOCKCHECK", "DATABLOCK",
+          "RESYNC", "SENDSTART", "SENDBLOCK", "SENDEOT"]
+CHARS = {0x01: "SOH", 0x02: "STX", 0x04: "EOT", 0x06: "ACK", 0x15: "NAK",
+         0x18: "CAN", 0x43: "C", 0x47: "G", 0x57: "W"}
+
+
+def state(a):
+    return STATES[a] if a < len(STATES) else "state %d" % a
+
+
+def char(a):
+    return CHARS.get(a, "0x%02X" % a)
+
+
+# Keep in step with xyevent.h
+EVENTS = {
+    1: lambda a, b: "state %s" % state(a),
+    2: lambda a, b: "header block %d size %d" % (a, b),
+    3: lambda a, b: "block %d ok" % a,
+    4: lambda a, b: "block %d BAD" % a,
+    5: lambda a, b: "send %s (block %d)" % (char(a), b),
+    6: lambda a, b: "TIMEOUT in %s" % state(a),
+    7: lambda a, b: "write start %d bytes" % b,
+    8: lambda a, b: "write end %d bytes" % b,
+    9: lambda a, b: "EOT",
+    10: lambda a, b: "resync, pending %s" % char(a),
+    11: lambda a, b: "file open, length & 0xFFFF = %d" % b,
+    12: lambda a, b: "file close",
+}
+
+
+def decode(lines):
+    events = None
+    for line in lines:
+        line = line.strip()
+        if line.startswith("XYEV "):
+            fields = line.split()
+            total, count = int(fields[2], 16), int(fields[3], 16)
+            if total > count:
+                print("# %d older events overwritten" % (total - count))
+            events = []
+        elif events is not None:
+            if line == "END":
+                break
+            if len(line) == 16:
+                events.append((int(line[0:8], 16), int(line[8:10], 16),
+                               int(line[10:12], 16), int(line[12:16], 16)))
+    if not events:
+        sys.exit("no event dump found")
+    first = prev = events[0][0]
+    for us, typ, a, b in events:
+        # 32 bit microsecond clock, differences modulo 2^32
+        since = ((us - first) & 0xFFFFFFFF) / 1000.0
+        delta = ((us - prev) & 0xFFFFFFFF) / 1000.0
+        prev = us
+        text = EVENTS.get(typ, lambda a, b: "event %d a=%d b=%d" % (typ, a, b))(a, b)
+        print("%10.3f %+9.3f  %s" % (since, delta, text))
+
+
+if __name__ == "__main__":
+    with (open(sys.argv[1], errors="replace") if len(sys.argv) > 1 else sys.stdin) as f:
+        decode(f)
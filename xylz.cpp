@@ -0,0 +1,172 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <Arduino.h>
+#include <xylz.h>
+
+bool XYlzSink::begin_file(const char *name, uint32_t length)
+{
+  size_t n = strlen(name);
+
+  lz = (n > 3) && (strcmp(name + n - 3, ".lz") == 0);
+  if (!lz) return out->begin_file(name, length);
+  nfiles++;
+  n -= 3;
+  if (n > sizeof(this->name) - 1) n = sizeof(this->name) - 1;
+  memcpy(this->name, name, n);
+  this->name[n] = '\0';
+  begun = false;
+  failed = false;
+  state = HEADER;
+  hdr_len = 0;
+  nflags = 0;
+  produced = 0;
+  wpos = 0;
+  flushed = 0;
+  return true;
+}
+
+/*
+ * Check the header and start the file on the wrapped sink.
+ */
+bool XYlzSink::header(void)
+{
+  if ((hdr[0] != 'X') || (hdr[1] != 'L') || (hdr[2] != 'Z') || (hdr[3] != 1)) {
+    return false;
+  }
+  length = (uint32_t)hdr[4] | ((uint32_t)hdr[5] << 8) |
+    ((uint32_t)hdr[6] << 16) | ((uint32_t)hdr[7] << 24);
+  begun = out->begin_file(name, length);
+  return begun;
+}
+
+size_t XYlzSink::write(const uint8_t *data, size_t len)
+{
+  if (!lz) return out->write(data, len);
+  if (failed) return 0;
+  for (size_t i = 0; (i < len) && ((state == HEADER) || (produced < length)); i++) {
+    uint8_t c = data[i];
+    switch (state) {
+      case HEADER:
+        hdr[hdr_len++] = c;
+        if (hdr_len == sizeof(hdr)) {
+          if (!header()) {
+            failed = true;
+            nerrors++;
+            return 0;
+          }
+          state = TOKEN;
+        }
+        break;
+      case TOKEN:
+        if (nflags == 0) {
+          flags = c;
+          nflags = 8;
+          break;
+        }
+        if (flags & 1) {
+          match_hi = c;
+          state = MATCH;
+        }
+        else {
+          put(c);
+        }
+        flags >>= 1;
+        nflags--;
+        break;
+      case MATCH: {
+        uint16_t code = ((uint16_t)match_hi << 8) | c;
+        uint16_t distance = (code >> 6) + 1;
+        if (distance > produced) {
+          // Reaches back before the start of the file, into window memory
+          // that was never written.
+          failed = true;
+          nerrors++;
+          return 0;
+        }
+        uint16_t from = wpos - distance;
+        uint8_t n = (code & 0x3F) + 3;
+        while ((n-- > 0) && (produced < length)) {
+          put(window[from++ & (WINDOW - 1)]);
+        }
+        state = TOKEN;
+        break;
+      }
+    }
+  }
+  flush();
+  return (failed) ? 0 : len;
+}
+
+/*
+ * Add one byte of output. The window doubles as the output buffer, it is
+ * handed on each time it fills.
+ */
+void XYlzSink::put(uint8_t c)
+{
+  window[wpos++] = c;
+  produced++;
+  if (wpos == WINDOW) {
+    flush();
+    wpos = 0;
+    flushed = 0;
+  }
+}
+
+void XYlzSink::flush(void)
+{
+  if (wpos > flushed) {
+    size_t n = wpos - flushed;
+    if (out->write(window + flushed, n) != n) {
+      failed = true;
+      nerrors++;
+    }
+    flushed = wpos;
+  }
+}
+
+bool XYlzSink::end_file(void)
+{
+  if (!lz) return out->end_file();
+  if (!begun) {
+    // Not even a whole header.
+    if (!failed) nerrors++;
+    return false;
+  }
+  flush();
+  bool good = out->end_file() && !failed;
+  if (produced != length) {
+    // Cut short, or not a complete stream.
+    if (!failed) nerrors++;
+    good = false;
+  }
+  return good;
+}
+
+void XYlzSink::cancel_file(const char *name)
+{
+  if (!lz) out->cancel_file(name);
+  else if (begun) out->cancel_file(this->name);
+}
@@ -0,0 +1,98 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef _XYLZ_H_
+#define _XYLZ_H_
+
+#include "xysink.h"
+
+/*
+ * Decompress while receiving. Files named *.lz made by xylz.py are
+ * decoded on the fly and passed to the wrapped sink without the .lz
+ * suffix. Other files go through as they are. The sender needs no changes
+ * and the line carries only the compressed bytes.
+ *
+ * Format, LZSS with a 1 KB window:
+ *    "XLZ" version(1) original length(4, little endian)
+ *    then groups of a flag byte and 8 items, flag bit 0 first:
+ *      0 = literal byte
+ *      1 = match, 2 bytes big endian: (distance - 1) << 6 | (length - 3)
+ *          distance 1..1024, length 3..66
+ *
+ * RAM is the 1 KB window, which also stages the output so the wrapped
+ * sink gets writes of up to 1 KB. The wrapped sink gets begin_file() with
+ * the original length once the header has arrived.
+ */
+class XYlzSink : public XYsink {
+  public:
+    static const uint16_t WINDOW = 1024;
+
+    XYlzSink(XYsink &out) {
+      this->out = &out;
+    };
+
+    // Compressed files seen, and those that failed to decode.
+    uint32_t files(void) { return nfiles; };
+    uint32_t errors(void) { return nerrors; };
+
+    virtual bool begin_file(const char *name, uint32_t length);
+    virtual size_t write(const uint8_t *data, size_t len);
+    // False if a compressed file did not decode to its full length. The
+    // wrapped sink then gets cancel_file() with the name it was given.
+    virtual bool end_file(void);
+    virtual void cancel_file(const char *name);
+    // Only files that were not compressed, the digest is of what came
+    // over the line.
+    virtual bool readable(void) { return !lz && out->readable(); };
+    virtual int read(uint32_t pos, uint8_t *data, size_t len) {
+      return (lz) ? -1 : out->read(pos, data, len);
+    };
+
+  private:
+    XYsink *out;
+    bool lz;                  // this file is compressed
+    bool begun;               // out has the file
+    bool failed;
+    enum { HEADER, TOKEN, MATCH } state;
+    char name[128+1];
+    uint8_t hdr[8];
+    uint8_t hdr_len;
+    uint8_t flags;
+    uint8_t nflags;           // items left in this flag group
+    uint8_t match_hi;
+    uint32_t length;          // original length
+    uint32_t produced;
+    uint16_t wpos;            // next byte of window
+    uint16_t flushed;         // window bytes before this are with out
+    uint32_t nfiles = 0;
+    uint32_t nerrors = 0;
+    uint8_t window[WINDOW];
+
+    void put(uint8_t c);
+    void flush(void);
+    bool header(void);
+};
+
+#endif /* _XYLZ_H_ */
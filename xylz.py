@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+# Compress files for XYlzSink (xylz.h), which decompresses them on the fly
+# while they are received. Send the .lz file with YMODEM, it is stored
+# under the original name.
+#
+#    ./xylz.py config.json          writes config.json.lz
+#    ./xylz.py -d config.json.lz    writes config.json, to check
+#
+# Keep the format in step with xylz.h.
+import struct
+import sys
+
+WINDOW = 1024
+MIN_MATCH = 3
+MAX_MATCH = 66
+CHAIN = 256     # candidates tried per position, more is slower and smaller
+
+
+def compress(data):
+    out = bytearray(b"XLZ\x01" + struct.pack("<I", len(data)))
+    heads = {}
+    items = []
+    i = 0
+    n = len(data)
+    while i < n:
+        best_len = 0
+        best_dist = 0
+        if i + MIN_MATCH <= n:
+            key = data[i:i + MIN_MATCH]
+            for j in reversed(heads.get(key, [])[-CHAIN:]):
+                if i - j > WINDOW:
+                    break
+                k = 0
+                while k < MAX_MATCH and i + k < n and data[j + k] == data[i + k]:
+                    k += 1
+                if k > best_len:
+                    best_len = k
+                    best_dist = i - j
+                    if k == MAX_MATCH:
+                        break
+        step = best_len if best_len >= MIN_MATCH else 1
+        for p in range(i, min(i + step, n - MIN_MATCH + 1)):
+            heads.setdefault(data[p:p + MIN_MATCH], []).append(p)
+        if best_len >= MIN_MATCH:
+            items.append((best_dist, best_len))
+        else:
+            items.append(data[i])
+        i += step
+    for g in range(0, len(items), 8):
+        group = items[g:g + 8]
+        flags = 0
+        body = bytearray()
+        for b, item in enumerate(group):
+            if isinstance(item, tuple):
+                flags |= 1 << b
+                body += struct.pack(">H", (item[0] - 1) << 6 | (item[1] - MIN_MATCH))
+            else:
+                body.append(item)
+        out.append(flags)
+        out += body
+    return bytes(out)
+
+
+def decompress(data):
+    if data[:4] != b"XLZ\x01":
+        raise ValueError("not an XLZ file")
+    length = struct.unpack("<I", data[4:8])[0]
+    out = bytearray()
+    i = 8
+    while len(out) < length:
+        flags = data[i]
+        i += 1
+        for b in range(8):
+            if len(out) >= length:
+                break
+            if flags & (1 << b):
+                code = data[i] << 8 | data[i + 1]
+                i += 2
+                dist = (code >> 6) + 1
+                for _ in range((code & 0x3F) + MIN_MATCH):
+                    out.append(out[-dist])
+            else:
+                out.append(data[i])
+                i += 1
+    return bytes(out[:length])
+
+
+def main(argv):
+    if len(argv) == 3 and argv[1] == "-d":
+        name = argv[2]
+        with open(name, "rb") as f:
+            data = decompress(f.read())
+        outname = name[:-3] if name.endswith(".lz") else name + ".out"
+    elif len(argv) == 2:
+        name = argv[1]
+        with open(name, "rb") as f:
+            raw = f.read()
+        data = compress(raw)
+        outname = name + ".lz"
+        print("%s: %d -> %d bytes" % (outname, len(raw), len(data)))
+    else:
+        sys.stderr.write("usage: xylz.py [-d] file\n")
+        return 2
+    with open(outname, "wb") as f:
+        f.write(data)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -24,9 +24,28 @@ SOFTWARE.
 
 #include <Arduino.h>
 #include <xymodem.h>
+#include <xycrc.h>
+#include <xytrace.h>
 
-#define dbprint(...) if(debugPort) debugPort->print(__VA_ARGS__)
-#define dbprintln(...) if(debugPort) debugPort->println(__VA_ARGS__)
+/*
+ * Format one trace line and write it to the debug port in one call.
+ */
+void xytrace_printf(Stream *debugPort, const char *fmt, ...)
+{
+  char line[96];
+  va_list ap;
+  int len;
+
+  if (debugPort == NULL) return;
+  va_start(ap, fmt);
+  len = vsnprintf(line, sizeof(line) - 2, fmt, ap);
+  va_end(ap);
+  if (len < 0) return;
+  if (len > (int)sizeof(line) - 3) len = sizeof(line) - 3;
+  line[len++] = '\r';
+  line[len++] = '\n';
+  debugPort->write((const uint8_t *)line, len);
+}
 
 /*
  * Start XMODEM receive. rx = receive XMODEM
@@ -34,396 +53,1585 @@ SOFTWARE.
 int XYmodem::start_rx(Stream &port, FS &filesys, const char *rx_filename, bool rx_buf_1k, bool useCRC)
 {
   YMODEM = false;
-  return start(&port, &filesys, rx_filename, rx_buf_1k, useCRC);
+  streaming = false;
+  return start(&port, &filesys, NULL, rx_filename, rx_buf_1k, useCRC);
 }
 
 /*
  * Start YMODEM receive. YMODEM is also known as batch mode. rb = receive batch.
+ * streaming = true requests YMODEM-G. The sender streams blocks without
+ * waiting for ACKs and any error cancels the transfer. Only use it on error
+ * free links such as USB. YMODEM-G always uses CRC.
+ */
+int XYmodem::start_rb(Stream &port, FS &filesys, bool rx_buf_1k, bool useCRC, bool streaming)
+{
+  YMODEM = true;
+  this->streaming = streaming;
+  return start(&port, &filesys, NULL, NULL, rx_buf_1k, useCRC || streaming);
+}
+
+int XYmodem::start_rb(Stream &port, FS &filesys, const char *rx_directory, bool rx_buf_1k, bool useCRC, bool streaming)
+{
+  YMODEM = true;
+  this->streaming = streaming;
+  return start(&port, &filesys, NULL, rx_directory, rx_buf_1k, useCRC || streaming);
+}
+
+int XYmodem::start_rb(FS &filesys, const char *rx_directory, bool rx_buf_1k, bool useCRC, bool streaming)
+{
+  YMODEM = true;
+  this->streaming = streaming;
+  return start(NULL, &filesys, NULL, rx_directory, rx_buf_1k, useCRC || streaming);
+}
+
+/*
+ * Receive into a sink. Same as with an FS except where the data goes.
  */
-int XYmodem::start_rb(Stream &port, FS &filesys, bool rx_buf_1k, bool useCRC)
+int XYmodem::start_rx(Stream &port, XYsink &sink, const char *rx_filename, bool rx_buf_1k, bool useCRC)
+{
+  YMODEM = false;
+  streaming = false;
+  return start(&port, NULL, &sink, rx_filename, rx_buf_1k, useCRC);
+}
+
+int XYmodem::start_rb(Stream &port, XYsink &sink, bool rx_buf_1k, bool useCRC, bool streaming)
 {
   YMODEM = true;
-  return start(&port, &filesys, NULL, rx_buf_1k, useCRC);
+  this->streaming = streaming;
+  return start(&port, NULL, &sink, "/", rx_buf_1k, useCRC || streaming);
 }
 
-int XYmodem::start_rb(Stream &port, FS &filesys, const char *rx_directory, bool rx_buf_1k, bool useCRC)
+int XYmodem::start_rb(XYsink &sink, bool rx_buf_1k, bool useCRC, bool streaming)
 {
   YMODEM = true;
-  return start(&port, &filesys, rx_directory, rx_buf_1k, useCRC);
+  this->streaming = streaming;
+  return start(NULL, NULL, &sink, "/", rx_buf_1k, useCRC || streaming);
 }
 
-int XYmodem::start(Stream *port, FS *filesys, const char *rx_filename, bool rx_buf_1k, bool useCRC)
+int XYmodem::start(Stream *port, FS *filesys, XYsink *sink, const char *rx_filename, bool rx_buf_1k, bool useCRC)
 {
+  if (rx_open) {
+    // Left open by a cancelled transfer.
+    this->sink->end_file();
+    rx_open = false;
+  }
+  if (sink == NULL) {
+    if (file_sink() == NULL) {
+      xytrace_error("XYmodem no file sink");
+      return 1;
+    }
+    fsink->attach(filesys, debugPort);
+    sink = fsink;
+  }
+  this->sink = sink;
   rx_buf_size = 128;
   if (rx_buf_1k) {
     rx_buf_size = 1024;
   }
-  dbprint("rx_buf_size=");
-  dbprintln(rx_buf_size);
-  if (rx_buf == NULL) {
-    rx_buf = (uint8_t*)malloc(rx_buf_size);
-    if (rx_buf == NULL) {
-      rxmodem.close();
-      dbprintln("XYmodem malloc failed");
-      return 1;
-    }
+  xytrace_state("rx_buf_size=%u", rx_buf_size);
+  if (alloc_buf(rx_buf_size)) {
+    return 1;
   }
+  rx_buf = blk_buf + 3;
+  // Write-behind slot: length, 2 spare bytes, data, checksum or CRC
+  pool_slot_size = (4 + rx_buf_size + 2 + 3) & ~3;
+  pool_slots = 0;
+  if (pool != NULL) {
+    size_t n = pool_len / pool_slot_size;
+    if (n > 128) n = 128;
+    while (n & (n - 1)) n &= n - 1;
+    if (n >= 2) pool_slots = n;
+  }
+  co_used = 0;
+  block_writes = file_writes = 0;
+  memset(&stats, 0, sizeof(stats));
+  if (hist != NULL) memset(hist, 0, sizeof(*hist));
+  last_block_valid = false;
+  pool_head = pool_tail = 0;
+  ack_pending = false;
+  eot_pending = false;
+  write_failed = false;
+  xytrace_state("write-behind slots=%u", pool_slots);
   CRC_on = useCRC;
   rxmodem_state = BLOCKSTART;
   next_block = 1;
-  reply = (CRC_on)? 'C' : NAK;
+  rtt_est.valid = false;
+  blk_est.valid = false;
+  rto_backoff = 0;
+  ack_timed = false;
+  blk_timed = false;
+  wreq_pending = (window > 0) && !streaming && CRC_on;
+  wreq_tries = 0;
+  windowed = false;
+  nak_outstanding = false;
+  ahead_mask = 0;
+  rx_ahead = false;
+  reply = start_char();
+  reply_cap = 0;
+  held_len = 0;
   this->port = port;
   this->fsptr = (FS *)filesys;
-  port->write(reply);
-  port->flush();
-  next_millis = millis()+ TIMEOUT_LONG;
+  send_reply();
+  next_millis = clock_ms() + timeout_long();
   if(YMODEM) {
     if (rx_filename != NULL && *rx_filename != '\0') {
-      strncpy(this->rx_dirname, (char *)rx_filename, sizeof(this->rx_filename)-1);
+      strncpy(this->rx_dirname, (char *)rx_filename, path_size-1);
+      this->rx_dirname[path_size-1] = '\0';
     } else {
       strcpy(this->rx_dirname, "");
     }
   } else if (rx_filename != NULL && *rx_filename != '\0') {
     strcpy(this->rx_dirname, "");
-    dbprint("rx file name (rx_buf)="); dbprintln((char *)rx_filename);
-    make_full_pathname((char*)rx_filename, this->rx_filename, sizeof(this->rx_filename)-1);
-    dbprint("XYmodem starting <"); dbprint(this->rx_filename); dbprintln('>');
-    this->fsptr->remove((char *)rx_filename);
-    rxmodem = this->fsptr->open(this->rx_filename, FILE_WRITE);
-    if (rxmodem) {
+    if (xy_full_pathname(rx_dirname, rx_filename, this->rx_filename, path_size-1) != 0) {
+      xytrace_error("pathname too long");
+      reply = CAN;
+      send_reply();
+      rxmodem_state = IDLE;
+      return 1;
+    }
+    xytrace_state("XYmodem starting <%s>", this->rx_filename);
+    if (sink->begin_file(this->rx_filename, XYsink::UNKNOWN_LENGTH)) {
+      rx_open = true;
+      file_opened();
       return 0;
     }
     else {
-      dbprintln("XYmodem open file failed");
+      xytrace_error("XYmodem open file failed <%s>", this->rx_filename);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Start XMODEM send. sx = send XMODEM
+ */
+int XYmodem::start_sx(Stream &port, FS &filesys, const char *tx_filename, bool tx_buf_1k)
+{
+  YMODEM = false;
+  if (tx_filename == NULL || *tx_filename == '\0') return 1;
+  if (alloc_buf((tx_buf_1k) ? 1024 : 128)) return 1;
+  strncpy(rx_filename, tx_filename, path_size-1);
+  rx_filename[path_size-1] = '\0';
+  rxmodem = filesys.open(rx_filename, FILE_READ);
+  if (!rxmodem) {
+    xytrace_error("tx file open failed <%s>", rx_filename);
+    return 1;
+  }
+  rx_file_remaining = rxmodem.size();
+  tx_size = rx_file_remaining;
+  tx_base = tx_next = 0;
+  xytrace_state("sx starting <%s> length=%lu", rx_filename,
+      (unsigned long)rx_file_remaining);
+  return start_send(&port, &filesys, tx_buf_1k);
+}
+
+/*
+ * Start YMODEM send. sb = send batch. The files are opened one at a time
+ * as the receiver asks for them.
+ */
+int XYmodem::start_sb(Stream &port, FS &filesys, const char *tx_directory,
+    const char * const *tx_files, uint8_t tx_count, bool tx_buf_1k)
+{
+  YMODEM = true;
+  // 1K also for block 0 in case the file name does not fit in 128
+  if (alloc_buf(1024)) return 1;
+  if (tx_directory != NULL && *tx_directory != '\0') {
+    strncpy(rx_dirname, tx_directory, path_size-1);
+    rx_dirname[path_size-1] = '\0';
+  } else {
+    strcpy(rx_dirname, "/");
+  }
+  this->tx_files = tx_files;
+  this->tx_count = tx_count;
+  return start_send(&port, &filesys, tx_buf_1k);
+}
+
+int XYmodem::start_send(Stream *port, FS *filesys, bool tx_buf_1k)
+{
+  this->port = port;
+  this->fsptr = filesys;
+  rx_buf = blk_buf + 3;
+  pool_slots = 0;
+  memset(&stats, 0, sizeof(stats));
+  tx_1k = tx_buf_1k;
+  tx_index = 0;
+  tx_retries = 0;
+  cancount = 0;
+  streaming = false;
+  windowed = false;
+  wreq_pending = false;
+  tx_resend = false;
+  tx_rlen = 0;
+  next_block = (YMODEM) ? 0 : 1;
+  rxmodem_state = SENDSTART;
+  next_millis = clock_ms() + TIMEOUT_SEND;
+  return 0;
+}
+
+/*
+ * Block buffer. The 3 byte block header goes in front of the data and the
+ * checksum or CRC after it so a block is sent straight from the buffer the
+ * file was read into. rx_buf points at the data. Grows if a later session
+ * needs bigger blocks, unless the storage is static. Also the two path
+ * buffers, once.
+ */
+int XYmodem::alloc_buf(uint16_t size)
+{
+  if (static_buf) {
+    if (blk_buf_size >= size) return 0;
+    xytrace_error("XYmodem %u byte blocks do not fit in %u", size, blk_buf_size);
+    return 1;
+  }
+  if (rx_filename == NULL) {
+    rx_filename = (char *)malloc(2 * path_size);
+    if (rx_filename == NULL) {
+      xytrace_error("XYmodem malloc failed");
       return 1;
     }
+    rx_dirname = rx_filename + path_size;
+    rx_dirname[0] = '\0';
   }
+  if (blk_buf != NULL && blk_buf_size >= size) return 0;
+  free(blk_buf);
+  blk_buf = (uint8_t*)malloc(3 + size + 2);
+  if (blk_buf == NULL) {
+    blk_buf_size = 0;
+    rx_buf = NULL;
+    xytrace_error("XYmodem malloc failed");
+    return 1;
+  }
+  blk_buf_size = size;
+  rx_buf = blk_buf + 3;
   return 0;
 }
 
-int XYmodem::loop(void)
+/*
+ * Use storage owned by the caller instead of the heap. blk holds a block
+ * of max_block bytes with its header and CRC, paths two path_size byte
+ * path names. files is the file sink, NULL for none.
+ */
+void XYmodem::setStorage(uint8_t *blk, uint16_t max_block, char *paths,
+    uint16_t path_size, XYfileSink *files, size_t obj_size)
+{
+  static_buf = true;
+  fsink = files;
+  blk_buf = blk;
+  blk_buf_size = max_block;
+  rx_buf = blk_buf + 3;
+  rx_filename = paths;
+  rx_dirname = paths + path_size;
+  rx_dirname[0] = '\0';
+  this->path_size = path_size;
+  this->obj_size = obj_size;
+}
+
+size_t XYmodem::footprint(void)
 {
-  static uint16_t blocksize;
-  static uint16_t blocksizenext;
-  static uint8_t block;
-  int inchar = 0;
-  static uint8_t *p;
-  static uint8_t datachecksum = 0;
-  static uint16_t CRC = 0;
-  static uint16_t CRCRx;
+  size_t n = obj_size;
+  if (!static_buf) {
+    if (blk_buf != NULL) n += 3 + blk_buf_size + 2;
+    if (rx_filename != NULL) n += 2 * path_size;
+    if (fsink != NULL) n += sizeof(XYfileSink);
+  }
+  return n;
+}
 
+int XYmodem::loop(uint32_t max_us)
+{
   if (rxmodem_state == IDLE) return 0;
+  int state = (rxmodem_state >= SENDSTART) ? tx_loop() : rx_loop(max_us);
+  event_state();
+  if ((state == IDLE) && (stats_cb != NULL)) {
+    stats_cb(stats, true);
+  }
+  return state;
+}
+
+/*
+ * Pull adapter over the receive parser. Bytes come from the port, the
+ * payload of a block straight into the block buffer.
+ */
+int XYmodem::rx_loop(uint32_t max_us)
+{
+  uint32_t start_us = (max_us != 0) ? clock_us() : 0;
 
-  if (millis() > next_millis) {
-    port->write(reply);
-    port->flush();
-    if (reply == NAK || reply == 'C') {
-      next_millis = millis() + TIMEOUT_LONG;
+  rx_pool();
+  if (rxmodem_state == IDLE) return rxmodem_state;
+  if (rx_timeout()) return rxmodem_state;
+  while (port->available() > 0) {
+    if ((max_us != 0) && (clock_us() - start_us >= max_us)) {
+      // Out of time. The parser state is all in the object so the next
+      // call carries on from this byte.
+      break;
+    }
+    event_state();
+    if (rxmodem_state == DATABLOCK) {
+      // Fast path. Pull the rest of the payload and its checksum or CRC
+      // straight into rx_buf then verify the whole block in one pass.
+      // Clamp before narrowing, available() may be above 65535.
+      size_t bytesAvail = port->available();
+      int bytesIn = port->readBytes((char *)rx_p, min(bytesAvail, (size_t)rx_bytesleft));
+      next_millis = clock_ms() + timeout_short();
+      rx_p += bytesIn;
+      rx_bytesleft -= bytesIn;
+      if (rx_bytesleft == 0) {
+        block_received(rx_block, rx_buf);
+      }
+      continue;
+    }
+    rx_byte(port->read());
+  } // while available()
+  return rxmodem_state;
+}
+
+size_t XYmodem::pending(void)
+{
+  size_t n = 0;
+
+  if (rxmodem_state == IDLE) return 0;
+  if (port != NULL) n = port->available();
+  for (uint8_t i = pool_tail; i != pool_head; i++) {
+    uint16_t len;
+    memcpy(&len, pool_slot(i), sizeof(len));
+    n += len;
+  }
+  return n;
+}
+
+/*
+ * Push adapter over the receive parser. data is used in place. Timeouts
+ * are checked after it, so a call with len 0 just runs the timers.
+ */
+size_t XYmodem::feed(const uint8_t *data, size_t len, uint8_t *reply, size_t reply_size)
+{
+  // Replies held from before go first, then the new ones straight in.
+  reply_len = min((size_t)held_len, reply_size);
+  if (reply_len > 0) {
+    memcpy(reply, held, reply_len);
+    held_len -= reply_len;
+    memmove(held, held + reply_len, held_len);
+  }
+  reply_buf = reply;
+  reply_cap = reply_size;
+  if ((rxmodem_state != IDLE) && (rxmodem_state < SENDSTART)) {
+    rx_pool();
+    while ((len > 0) && (rxmodem_state != IDLE)) {
+      event_state();
+      if (rxmodem_state != DATABLOCK) {
+        rx_byte(*data++);
+        len--;
+        continue;
+      }
+      uint16_t n;
+      next_millis = clock_ms() + timeout_short();
+      if ((rx_p == rx_buf) && (len >= rx_bytesleft) && (pool_slots == 0) &&
+          (rx_block != 0)) {
+        // The whole block is in data. Check it and write it from there.
+        // Block 0 is copied, its file name is kept and parsed.
+        n = rx_bytesleft;
+        rx_bytesleft = 0;
+        block_received(rx_block, data);
+      }
+      else {
+        n = min((size_t)rx_bytesleft, len);
+        memcpy(rx_p, data, n);
+        rx_p += n;
+        rx_bytesleft -= n;
+        if (rx_bytesleft == 0) {
+          block_received(rx_block, rx_buf);
+        }
+      }
+      data += n;
+      len -= n;
+    }
+    if (rxmodem_state != IDLE) rx_timeout();
+    event_state();
+    if ((rxmodem_state == IDLE) && (stats_cb != NULL)) {
+      stats_cb(stats, true);
+    }
+  }
+  reply_buf = NULL;
+  reply_cap = 0;
+  return reply_len;
+}
+
+/*
+ * Write-behind housekeeping: drain, and send the ACK or handle the EOT
+ * held back for a free slot.
+ */
+void XYmodem::rx_pool(void)
+{
+  if (pool_slots == 0) return;
+  if (!drain_external) drain();
+  if (write_check()) return;
+  if (ack_pending && (pool_count() < pool_slots)) {
+    ack_pending = false;
+    send_ack(ack_block);
+  }
+  if (eot_pending && (pool_count() == 0)) {
+    eot_pending = false;
+    eot_received();
+  }
+  if (ack_pending || eot_pending) {
+    // The sender is waiting for us, not the other way round.
+    next_millis = clock_ms() + timeout_short();
+  }
+}
+
+/*
+ * Send the reply again if the sender went quiet. True if it timed out.
+ */
+bool XYmodem::rx_timeout(void)
+{
+  if (timed_out()) {
+    if (reply == 'W' && ++wreq_tries >= WINDOW_TRIES) {
+      // The sender does not understand windowed mode. Fall back to
+      // classic XMODEM/YMODEM.
+      xytrace_error("no reply to W, windowed mode off");
+      wreq_pending = false;
+      reply = start_char();
+    }
+    if (rtt_est.valid && (rto_backoff < 4)) {
+      // Like TCP, wait twice as long after each timeout until the next
+      // measurement.
+      rto_backoff++;
+    }
+    ack_timed = false;
+    blk_timed = false;
+    stats.timeouts++;
+    event(XYEV_TIMEOUT, rxmodem_state);
+    if (windowed && rx_open && (reply == start_char())) {
+      // Name the block wanted, the sender may be waiting for an ACK.
+      send_nak();
+    }
+    else {
+      send_reply();
+    }
+    if (reply == NAK || reply == 'C' || reply == 'G' || reply == 'W') {
+      next_millis = clock_ms() + timeout_long();
       rxmodem_state = BLOCKSTART;
-      dbprintln("timeout, send NAK or C");
+      xytrace_error("timeout, send 0x%02X", reply);
     }
     else if (reply == CAN) {
       rxmodem_state = IDLE;
       reply = NAK;
-      dbprintln("timeout, send CAN");
+      xytrace_error("timeout, send CAN");
     }
-    return rxmodem_state;
+    return true;
   }
-  while (port->available() > 0) {
-    inchar = port->read();
-    next_millis = millis() + TIMEOUT_SHORT;
-    dbprint("inchar=0x"); dbprintln(inchar, HEX);
-    switch (rxmodem_state) {
-      case IDLE:
-        break;
-      case BLOCKSTART:
-        dbprint("BLOCKSTART 0x"); dbprintln(inchar, HEX);
-        switch (inchar) {
-          case SOH:
-            blocksize = blocksizenext = 128;
+  return false;
+}
+
+/*
+ * Receive parser for one byte outside the block payload.
+ */
+void XYmodem::rx_byte(uint8_t inchar)
+{
+  next_millis = clock_ms() + ((rxmodem_state == RESYNC) ? TIMEOUT_GAP : timeout_short());
+  xytrace_byte("state=%d inchar=0x%02X", rxmodem_state, inchar);
+  switch (rxmodem_state) {
+    case IDLE:
+    case DATABLOCK:
+    case SENDSTART:
+    case SENDBLOCK:
+    case SENDEOT:
+      break;
+    case BLOCKSTART:
+      if (ack_timed) {
+        rtt_sample(rtt_est, clock_ms() - ack_ms);
+        rto_backoff = 0;
+        ack_timed = false;
+      }
+      blk_ms = clock_ms();
+      blk_timed = true;
+      switch (inchar) {
+        case SOH:
+          blocksize = 128;
+          rxmodem_state = BLOCKNUM;
+          break;
+        case STX:
+          blocksize = 1024;
+          if (blocksize > rx_buf_size) {
+            reply = nak_char();
+            resync(0, inchar);
+          }
+          else {
             rxmodem_state = BLOCKNUM;
-            break;
-          case STX:
-            blocksize = blocksizenext = 1024;
-            if (blocksize > rx_buf_size) {
-              reply = NAK;
-              rxmodem_state = DATAPURGE;
-            }
-            else {
-              rxmodem_state = BLOCKNUM;
-            }
-            break;
-          case EOT:
-            port->write(ACK);
-            port->flush();
-            next_block = 1;
-            if (rxmodem) {
-              dbprint("YMODEM="); dbprintln(YMODEM, DEC);
-              dbprint("filename="); dbprintln(rx_filename);
-              if (YMODEM && ((strcmp(rx_filename, "") == 0) || (strcmp(rx_filename, "/") == 0)))
-                rxmodem_state = IDLE;
-              else
-                rxmodem_state = BLOCKSTART;
-              rxmodem.close();
-            }
-            else {
-              rxmodem_state = IDLE;
-            }
-            break;
-        }
-        break;
-      case BLOCKNUM:
-        dbprint("BLOCKNUM block=");
-        block = inchar;
-        dbprintln(block);
-        rxmodem_state = BLOCKCHECK;
-        break;
-      case BLOCKCHECK:
-        dbprint("BLOCKCHECK blockchk=0x");
-        dbprintln((uint8_t)(inchar ^ block), HEX);
-        if ((uint8_t)(inchar ^ block) == 0xFF) {
-          if (((block == next_block) || (block == (next_block-1)))) {
-            p = rx_buf;
-            datachecksum = 0;
-            CRC = 0;
-            rxmodem_state = DATABLOCK;
+          }
+          break;
+        case EOT:
+          if (pool_count() != 0) {
+            // ACK once the queued blocks are in the file.
+            eot_pending = true;
           }
           else {
-            reply = CAN;
-            rxmodem_state = DATAPURGE;
+            eot_received();
           }
+          break;
+        default:
+          // Not a block header. Look for one in what follows and send
+          // the reply once the line goes quiet.
+          resync(0, inchar);
+          break;
+      }
+      break;
+    case BLOCKNUM:
+      rx_block = inchar;
+      rxmodem_state = BLOCKCHECK;
+      break;
+    case BLOCKCHECK:
+      if ((uint8_t)(inchar ^ rx_block) == 0xFF) {
+        if (wreq_pending) {
+          // The sender answered W so it is windowed.
+          xytrace_state("windowed mode, window=%u", window);
+          windowed = true;
+          wreq_pending = false;
+        }
+        if (block_expected(rx_block)) {
+          event(XYEV_HEADER, rx_block, blocksize);
+          block_start();
+          rx_p = rx_buf;
+          rx_bytesleft = blocksize + ((CRC_on) ? 2 : 1);
+          rxmodem_state = DATABLOCK;
         }
         else {
-          reply = NAK;
-          rxmodem_state = DATAPURGE;
+          xytrace_error("block %u out of sequence, expected %u", rx_block, next_block);
+          reply = CAN;
+          resync(rx_block, inchar);
         }
-        break;
-      case DATABLOCK:
-        dbprintln("DATABLOCK");
-        *p++ = inchar;
-        if (CRC_on) {
-          CRC = updcrc(inchar, CRC);
+      }
+      else {
+        xytrace_error("bad block number 0x%02X 0x%02X", rx_block, inchar);
+        reply = nak_char();
+        resync(rx_block, inchar);
+      }
+      break;
+    case RESYNC:
+      // Slide a 3 byte window over the input. Anything that cannot start
+      // a header of a block we want is garbage.
+      hdr_win[0] = hdr_win[1];
+      hdr_win[1] = hdr_win[2];
+      hdr_win[2] = inchar;
+      if (((hdr_win[0] == SOH) || ((hdr_win[0] == STX) && (rx_buf_size >= 1024))) &&
+          ((uint8_t)(hdr_win[1] ^ hdr_win[2]) == 0xFF) &&
+          block_expected(hdr_win[1])) {
+        blocksize = (hdr_win[0] == STX) ? 1024 : 128;
+        rx_block = hdr_win[1];
+        xytrace_error("resync at block %u", rx_block);
+        event(XYEV_HEADER, rx_block, blocksize);
+        block_start();
+        rx_p = rx_buf;
+        rx_bytesleft = blocksize + ((CRC_on) ? 2 : 1);
+        rxmodem_state = DATABLOCK;
+        next_millis = clock_ms() + timeout_short();
+      }
+      break;
+  }
+}
+
+/*
+ * Add a measurement to a smoothed estimate. Same gains as TCP (RFC 6298):
+ * 1/8 for the mean, 1/4 for the deviation.
+ */
+void XYmodem::rtt_sample(rtt_est_t &est, uint32_t ms)
+{
+  if (!est.valid) {
+    est.srtt = ms;
+    est.rttvar = ms / 2;
+    est.valid = true;
+  }
+  else {
+    uint32_t delta = (ms > est.srtt) ? ms - est.srtt : est.srtt - ms;
+    est.rttvar = est.rttvar - (est.rttvar >> 2) + (delta >> 2);
+    est.srtt = est.srtt - (est.srtt >> 3) + (ms >> 3);
+  }
+}
+
+/*
+ * Timeout from an estimate, mean plus 4 deviations, doubled backoff times,
+ * kept between tmo_min and tmo_max. initial is used until there is a
+ * measurement.
+ */
+uint32_t XYmodem::rto(const rtt_est_t &est, uint32_t initial, uint8_t backoff)
+{
+  uint32_t ms = (tmo_adaptive && est.valid) ? est.srtt + 4 * est.rttvar : initial;
+  if (ms < tmo_min) ms = tmo_min;
+  ms <<= backoff;
+  if (ms > tmo_max) ms = tmo_max;
+  return ms;
+}
+
+/*
+ * True if block is one the receiver can take now: the next one, a repeat of
+ * the last one, or when windowed one inside the window.
+ */
+bool XYmodem::block_expected(uint8_t block)
+{
+  return (block == next_block) || (block == (uint8_t)(next_block-1)) ||
+    (windowed && (((uint8_t)(block - next_block) < window) ||
+                  ((uint8_t)(next_block - block) <= window)));
+}
+
+/*
+ * Pick the buffer the block data goes into. When windowed, a block ahead
+ * of a lost one goes to the slot it will have once the lost one is queued,
+ * if that slot is free.
+ */
+void XYmodem::block_start(void)
+{
+  rx_ahead = false;
+  if (pool_slots > 0) {
+    uint8_t ahead = rx_block - next_block;
+    if (windowed && (ahead > 0) && (ahead < window) &&
+        ((uint8_t)(pool_count() + ahead) < pool_slots) &&
+        !(ahead_mask & (1 << ahead))) {
+      rx_ahead = true;
+      rx_buf = pool_slot(pool_head + ahead) + 4;
+      return;
+    }
+    // Only YMODEM-G and windowed senders get here with the pool full, the
+    // others wait for the ACK.
+    while (pool_count() >= pool_slots) {
+      if (drain_external) yield();
+      else drain();
+    }
+    rx_buf = pool_slot(pool_head) + 4;
+  }
+}
+
+/*
+ * Lost block sync. b1 and b2 are the last bytes taken as a header, the
+ * real one may start in them. The reply goes out when the line is quiet
+ * for TIMEOUT_GAP, unless a good header turns up first.
+ */
+void XYmodem::resync(uint8_t b1, uint8_t b2)
+{
+  event(XYEV_RESYNC, reply);
+  blk_timed = false;
+  hdr_win[0] = 0;
+  hdr_win[1] = b1;
+  hdr_win[2] = b2;
+  rxmodem_state = RESYNC;
+  next_millis = clock_ms() + TIMEOUT_GAP;
+}
+
+/*
+ * The whole block including its checksum or CRC is at blk, rx_buf or the
+ * caller's data in feed(). Verify it, reply ACK or NAK, and pass good data
+ * on. Block 0 and write-behind blocks are always in rx_buf.
+ */
+void XYmodem::block_received(uint8_t block, const uint8_t *blk)
+{
+  bool good;
+
+  if (CRC_on) {
+    // The CRC of the data followed by its own CRC is zero.
+    good = (XYcrc16::update(0, blk, blocksize + 2) == 0);
+  }
+  else {
+    uint8_t datachecksum = 0;
+    for (uint16_t i = 0; i < blocksize; i++) {
+      datachecksum += blk[i];
+    }
+    good = (datachecksum == blk[blocksize]);
+  }
+  event((good) ? XYEV_BLOCK_OK : XYEV_BLOCK_BAD, block);
+  rxmodem_state = BLOCKSTART;
+  if (streaming && (!good || (block != next_block && block != 0))) {
+    // YMODEM-G has no retransmission. Any error ends the transfer.
+    xytrace_error("YMODEM-G block %u bad, cancel", block);
+    put(CAN);
+    put(CAN);
+    put_flush();
+    pool_flush();
+    if (rx_open) file_close();
+    rxmodem_state = IDLE;
+    return;
+  }
+  if (good && blk_timed) {
+    rtt_sample(blk_est, clock_ms() - blk_ms);
+  }
+  blk_timed = false;
+  if (!good) {
+    stats.bad_checks++;
+    xytrace_error("block %u checksum bad", block);
+    send_nak();
+    return;
+  }
+  if (windowed && (block != next_block) && !((block == 0) && (next_block == 1))) {
+    if ((uint8_t)(next_block - block) <= window) {
+      // Repeat of a block already written. The sender went back further
+      // than it needed to.
+      stats.duplicates++;
+      send_ack(block);
+      return;
+    }
+    if (rx_ahead) {
+      // Kept until the lost block arrives. Its length is settled then.
+      uint16_t len = blocksize;
+      memcpy(rx_buf - 4, &len, sizeof(len));
+      ahead_mask |= 1 << (uint8_t)(block - next_block);
+    }
+    if (!nak_outstanding) {
+      // A block was lost. Ask for it again. Without a slot for them the
+      // blocks after it are dropped until it arrives, the sender goes back
+      // to it.
+      xytrace_error("block %u lost, got %u", next_block, block);
+      send_nak();
+    }
+    return;
+  }
+  if (block == next_block) {
+    uint32_t now_us = clock_us();
+    if (last_block_valid && (hist != NULL)) {
+      hist_add(hist->interarrival, now_us - last_block_us);
+    }
+    last_block_us = now_us;
+    last_block_valid = true;
+    stats.blocks++;
+    nak_outstanding = false;
+    next_block++;
+    uint32_t bytesOut = min((uint32_t)blocksize, rx_file_remaining);
+    if(!YMODEM) bytesOut = blocksize; // with XMODEM transfer, expepcted length is unknown
+    rx_file_remaining -= bytesOut;
+    xytrace_block("block %u bytesOut=%lu rx_file_remaining=%lu", block,
+        (unsigned long)bytesOut, (unsigned long)rx_file_remaining);
+    if (pool_slots > 0) {
+      uint16_t len = bytesOut;
+      memcpy(rx_buf - 4, &len, sizeof(len));
+      __sync_synchronize();
+      pool_head = pool_head + 1;
+      ahead_mask >>= 1;
+      while (ahead_mask & 1) {
+        // Came in ahead of it and waits in the next slot. The ACK covers
+        // it too.
+        uint8_t *slot = pool_slot(pool_head);
+        memcpy(&len, slot, sizeof(len));
+        if (YMODEM) len = min((uint32_t)len, rx_file_remaining);
+        memcpy(slot, &len, sizeof(len));
+        rx_file_remaining -= len;
+        stats.blocks++;
+        block = next_block++;
+        ahead_mask >>= 1;
+        __sync_synchronize();
+        pool_head = pool_head + 1;
+      }
+      if (!streaming) {
+        if (pool_count() < pool_slots) {
+          send_ack(block);
         }
         else {
-          datachecksum += inchar;
+          xytrace_block("pool full, ACK %u held", block);
+          ack_pending = true;
+          ack_block = block;
         }
-        blocksize--;
-        if (blocksize == 0) {
-          rxmodem_state = DATACHECK;
+      }
+    }
+    else {
+      if (!streaming) {
+        send_ack(block);
+      }
+      file_write(blk, bytesOut);
+      if (write_check()) return;
+    }
+    next_millis = clock_ms() + timeout_long();
+  }
+  else {
+    if (!streaming) {
+      send_ack(block);
+    }
+    if (block != 0) {
+      stats.duplicates++;
+      return;
+    }
+    // ymodem block 0 file name, file size, etc. Nothing past the block is
+    // read, the name must end inside it.
+    const uint8_t *name_end = (const uint8_t *)memchr(rx_buf, '\0', blocksize);
+    if (name_end == NULL) {
+      xytrace_error("block 0 file name not terminated");
+      reply = CAN;
+      send_reply();
+      rxmodem_state = IDLE;
+      return;
+    }
+    int path_err = xy_full_pathname(rx_dirname, (char*)rx_buf, rx_filename, path_size-1);
+    if ((rx_buf[0] != '\0') && (path_err != 0)) {
+      // Directory and name do not fit in the path buffer.
+      xytrace_error("pathname too long");
+      reply = CAN;
+      send_reply();
+      rxmodem_state = IDLE;
+      return;
+    }
+    if (rx_buf[0] != '\0') {
+      rx_filename[path_size-1] = '\0';
+      char length[12];
+      size_t n = min(sizeof(length) - 1,
+          (size_t)(rx_buf + blocksize - (name_end + 1)));
+      memcpy(length, name_end + 1, n);
+      length[n] = '\0';
+      rx_file_remaining = strtoul(length, NULL, 10);
+      xytrace_state("rxmodem starting <%s> length=%lu", rx_filename,
+          (unsigned long)rx_file_remaining);
+      if (!sink->begin_file(rx_filename,
+            (*length != '\0') ? rx_file_remaining : XYsink::UNKNOWN_LENGTH)) {
+        // Refused, for example no space. Cancel now rather than fail half
+        // way through the file.
+        xytrace_error("rx file refused <%s>", rx_filename);
+        reply = CAN;
+        send_reply();
+        rxmodem_state = IDLE;
+        return;
+      }
+      rx_open = true;
+      file_opened();
+      next_block = 1;
+      ahead_mask = 0;
+      reply = start_char();
+      send_reply();
+      next_millis = clock_ms() + timeout_long();
+    }
+    else {
+      rxmodem_state = IDLE;
+    }
+  }
+}
+
+/*
+ * End of file. ACK it, close the file and in YMODEM ask for the next file.
+ * When windowed the ACK carries the number after the last block, so the
+ * sender can tell it from a late ACK of a block.
+ */
+void XYmodem::eot_received(void)
+{
+  uint8_t eot_block = next_block;
+
+  event(XYEV_EOT, 0);
+  next_block = 1;
+  ahead_mask = 0;
+  if (rx_open) {
+    xytrace_state("EOT YMODEM=%d filename=%s", YMODEM, rx_filename);
+    if (!file_close()) {
+      // What is in the file is not what was sent. Tell the sender instead
+      // of ACKing.
+      reply = CAN;
+      send_reply();
+      rxmodem_state = IDLE;
+      return;
+    }
+    send_eot_ack(eot_block);
+    if (!YMODEM || (strcmp(rx_filename, "") == 0) || (strcmp(rx_filename, "/") == 0))
+      rxmodem_state = IDLE;
+    else
+      rxmodem_state = BLOCKSTART;
+    if (YMODEM && rxmodem_state == BLOCKSTART) {
+      // Ask for the next block 0 now instead of after a timeout.
+      reply = start_char();
+      send_reply();
+      next_millis = clock_ms() + timeout_long();
+    }
+  }
+  else {
+    send_eot_ack(eot_block);
+    rxmodem_state = IDLE;
+  }
+}
+
+int XYmodem::drain(void)
+{
+  uint8_t head = pool_head;
+  if (pool_tail == head) return 0;
+  __sync_synchronize();
+  uint8_t *slot = pool_slot(pool_tail);
+  uint16_t len;
+  memcpy(&len, slot, sizeof(len));
+  file_write(slot + 4, len);
+  __sync_synchronize();
+  pool_tail = pool_tail + 1;
+  return (uint8_t)(head - pool_tail);
+}
+
+/*
+ * Write received data to the file. With coalescing only whole chunks at
+ * chunk aligned offsets are written. Data that covers a whole chunk with
+ * nothing buffered goes straight to the file without a copy.
+ */
+void XYmodem::file_write(const uint8_t *data, size_t len)
+{
+  block_writes++;
+  if (co_buf == NULL) {
+    sink_write(data, len);
+    return;
+  }
+  while (len > 0) {
+    size_t n;
+    if ((co_used == 0) && (len >= co_size)) {
+      n = len - (len % co_size);
+      sink_write(data, n);
+    }
+    else {
+      n = min(len, (size_t)(co_size - co_used));
+      memcpy(co_buf + co_used, data, n);
+      co_used += n;
+      if (co_used == co_size) {
+        sink_write(co_buf, co_size);
+        co_used = 0;
+      }
+    }
+    data += n;
+    len -= n;
+  }
+}
+
+/*
+ * Write what is left in the coalescing buffer, verify and close the file.
+ * False if a write failed, the file read back does not match or the sink
+ * found it bad.
+ */
+bool XYmodem::file_close(void)
+{
+  bool good;
+
+  if (co_used > 0) {
+    sink_write(co_buf, co_used);
+    co_used = 0;
+  }
+  xytrace_state("file writes=%lu saved=%ld", (unsigned long)file_writes,
+      (long)writesSaved());
+  good = !write_failed;
+  if (good && (verify_buf != NULL)) {
+    good = verify();
+  }
+  stats.file_crc32 = file_crc;
+  if (!sink->end_file()) {
+    // Cut short or corrupt, for example a compressed stream.
+    xytrace_error("sink rejected <%s>", rx_filename);
+    sink->cancel_file(rx_filename);
+    good = false;
+  }
+  rx_open = false;
+  event(XYEV_FILE_CLOSE, 0);
+  stats.files++;
+  stats.file_ms = clock_ms() - file_start_ms;
+  stats.file_bytes_per_s = (stats.file_ms > 0) ?
+    (uint32_t)((uint64_t)stats.file_bytes * 1000 / stats.file_ms) : 0;
+  if (stats_cb != NULL) {
+    stats_cb(stats, false);
+  }
+  return good;
+}
+
+/*
+ * Read the file back from the sink and compare its CRC-32 with the one of
+ * the data written.
+ */
+bool XYmodem::verify(void)
+{
+  uint32_t crc = 0;
+  uint32_t pos = 0;
+
+  if (!sink->readable()) return true;
+  while (pos < stats.file_bytes) {
+    int n = sink->read(pos, verify_buf,
+        min((uint32_t)verify_len, stats.file_bytes - pos));
+    if (n <= 0) break;
+    crc = XYcrc32::update(crc, verify_buf, n);
+    pos += n;
+  }
+  if ((pos != stats.file_bytes) || (crc != file_crc)) {
+    xytrace_error("verify failed <%s> %lu of %lu bytes crc %08lx, wrote %08lx",
+        rx_filename, (unsigned long)pos, (unsigned long)stats.file_bytes,
+        (unsigned long)crc, (unsigned long)file_crc);
+    stats.verify_errors++;
+    return false;
+  }
+  stats.verified++;
+  return true;
+}
+
+/*
+ * Cancel the transfer if a write failed. True if it did.
+ */
+bool XYmodem::write_check(void)
+{
+  if (!write_failed) return false;
+  reply = CAN;
+  send_reply();
+  // Blocks still queued go to the sink before it is closed.
+  pool_flush();
+  if (rx_open) file_close();
+  rxmodem_state = IDLE;
+  return true;
+}
+
+/*
+ * Finish a copy, so the context is left as it is.
+ */
+bool XYmodem::fileSha256(uint8_t digest[XYsha256::DIGEST_SIZE])
+{
+  if (file_sha == NULL) return false;
+  XYsha256 copy = *file_sha;
+  copy.finish(digest);
+  return true;
+}
+
+/*
+ * Start the per file statistics.
+ */
+void XYmodem::file_opened(void)
+{
+  event(XYEV_FILE_OPEN, 0, (uint16_t)rx_file_remaining);
+  file_start_ms = clock_ms();
+  file_crc = 0;
+  if (file_sha != NULL) file_sha->begin();
+  stats.file_bytes = 0;
+  stats.file_ms = 0;
+  stats.file_bytes_per_s = 0;
+}
+
+/*
+ * The one place received data goes to the sink. Times the write.
+ */
+void XYmodem::sink_write(const uint8_t *data, size_t len)
+{
+  event(XYEV_WRITE_START, 0, len);
+  uint32_t start_us = clock_us();
+  size_t n = sink->write(data, len);
+  if (hist != NULL) hist_add(hist->write, clock_us() - start_us);
+  event(XYEV_WRITE_END, 0, n);
+  file_writes++;
+  if (n != len) {
+    // Full file system, flash error. The receive side cancels.
+    xytrace_error("write failed, %u of %u bytes", (unsigned)n, (unsigned)len);
+    stats.write_errors++;
+    write_failed = true;
+    if (n > len) n = 0;
+  }
+  file_crc = XYcrc32::update(file_crc, data, n);
+  if (file_sha != NULL) file_sha->update(data, n);
+  stats.bytes += n;
+  stats.file_bytes += n;
+}
+
+/*
+ * Event dump format, one line each, all numbers hex:
+ *   XYEV <version> <events recorded> <events in dump>
+ *   <us 8 digits><type 2 digits><a 2 digits><b 4 digits>
+ *   END
+ */
+void XYmodem::dumpEvents(Print &out)
+{
+  char line[24];
+  uint32_t n = 0;
+  uint32_t first = 0;
+
+  if (ev_buf != NULL) {
+    n = (ev_total > (uint32_t)ev_mask + 1) ? (uint32_t)ev_mask + 1 : ev_total;
+    first = ev_total - n;
+  }
+  snprintf(line, sizeof(line), "XYEV 1 %lx %lx", (unsigned long)ev_total,
+      (unsigned long)n);
+  out.println(line);
+  for (uint32_t i = 0; i < n; i++) {
+    const xyevent_t *e = &ev_buf[(first + i) & ev_mask];
+    snprintf(line, sizeof(line), "%08lx%02x%02x%04x", (unsigned long)e->us,
+        e->type, e->a, e->b);
+    out.println(line);
+  }
+  out.println("END");
+}
+
+/*
+ * Count us in its log2 bin.
+ */
+void XYmodem::hist_add(uint32_t *hist, uint32_t us)
+{
+  uint8_t bin = 0;
+  while ((us != 0) && (bin < HIST_BINS - 1)) {
+    us >>= 1;
+    bin++;
+  }
+  hist[bin]++;
+}
+
+/*
+ * Wait until every queued block is in the file.
+ */
+void XYmodem::pool_flush(void)
+{
+  while (pool_count() != 0) {
+    if (drain_external) yield();
+    else drain();
+  }
+}
+
+/*
+ * Send side of loop(). Waits for the receiver to ask for the file with 'C'
+ * (CRC) or NAK (checksum), then sends a block and waits for its ACK. NAK or
+ * a timeout sends the block again. When the receiver asks with 'W' and the
+ * window is set, data blocks are sent windowed, see tx_fill().
+ */
+int XYmodem::tx_loop(void)
+{
+  if (timed_out()) {
+    if (++tx_retries > SEND_TRIES) {
+      xytrace_error("send timeout, cancel");
+      reply = CAN;
+      send_reply();
+      rxmodem.close();
+      rxmodem_state = IDLE;
+      return rxmodem_state;
+    }
+    xytrace_error("timeout, state=%d", rxmodem_state);
+    event(XYEV_TIMEOUT, rxmodem_state);
+    tx_rlen = 0;
+    if ((rxmodem_state == SENDBLOCK) && windowed && !tx_block0) {
+      // No ACK for a while. Go back to the oldest block not ACKed.
+      tx_next = tx_base;
+      tx_resend = false;
+      tx_fill();
+    }
+    else if (rxmodem_state == SENDBLOCK) {
+      send_block();
+    }
+    else if (rxmodem_state == SENDEOT) {
+      port->write(EOT);
+      port->flush();
+    }
+    next_millis = clock_ms() + TIMEOUT_SEND;
+    return rxmodem_state;
+  }
+  while ((rxmodem_state != IDLE) && (port->available() > 0)) {
+    int inchar = port->read();
+    xytrace_byte("state=%d inchar=0x%02X", rxmodem_state, inchar);
+    if (tx_rlen > 0) {
+      // The rest of a windowed reply. CAN may be one of its bytes.
+      if (!tx_reply_byte(inchar)) continue;
+      inchar = tx_reply;
+    }
+    else if (inchar == CAN) {
+      if (++cancount >= 2) {
+        xytrace_error("cancelled by receiver");
+        rxmodem.close();
+        rxmodem_state = IDLE;
+      }
+      continue;
+    }
+    else if (tx_reply_start(inchar)) {
+      continue;
+    }
+    cancount = 0;
+    switch (rxmodem_state) {
+      case SENDSTART:
+        if ((inchar == 'W') && (window > 0) && !windowed) {
+          // The receiver asks for windowed mode, which needs CRC.
+          xytrace_state("windowed send, window=%u", min(window, tx_rnum));
+          windowed = true;
+          tx_window = min(window, tx_rnum);
+          CRC_on = true;
+          inchar = 'C';
         }
-        else {
-          int bytesAvail, bytesIn;
-          bytesAvail = port->available();
-          dbprint("bytesAvail=");
-          dbprintln(bytesAvail);
-          if (bytesAvail > 0) {
-            bytesIn = port->readBytes((char *)p, min((uint16_t)bytesAvail, blocksize));
-            dbprint("blocksize=");
-            dbprint(blocksize);
-            dbprint(" bytesIn=");
-            dbprintln(bytesIn);
-            while (bytesIn--) {
-              if (CRC_on) {
-                CRC = updcrc(*p++, CRC);
-              }
-              else {
-                datachecksum += *p++;
-              }
-              blocksize--;
-            }
-            if (blocksize == 0) rxmodem_state = DATACHECK;
+        if (inchar == 'C' || inchar == NAK) {
+          // A windowed receiver that timed out NAKs, it still wants CRC.
+          if (!windowed) CRC_on = (inchar == 'C');
+          tx_retries = 0;
+          tx_block0 = (next_block == 0);
+          if (tx_block0) {
+            tx_header();
+          }
+          else if (windowed) {
+            tx_fill();
+          }
+          else {
+            tx_data();
           }
         }
         break;
-      case DATACHECK:
-        if (CRC_on) {
-          dbprint("DATACHECK CRC=0x");
-          dbprintln(CRC, HEX);
-          CRCRx = inchar << 8;
-          rxmodem_state = DATACHECKCRC;
+      case SENDBLOCK:
+        if (windowed && !tx_block0) {
+          tx_window_reply(inchar);
         }
-        else {
-          dbprint("DATACHECK datachecksum=0x");
-          dbprintln(datachecksum, HEX);
-          if (datachecksum == inchar) {
-            dbprintln("Checksum OK");
-            port->write(ACK);
-            port->flush();
-            if (block == next_block) {
-              dbprintln("Good block");
-              next_block++;
-              uint32_t bytesOut = min((uint32_t)blocksizenext, rx_file_remaining);
-              if(!YMODEM) bytesOut = blocksizenext; // with XMODEM transfer, expepcted length is unknown
-              rxmodem.write(rx_buf, bytesOut);
-              rx_file_remaining -= bytesOut;
-              dbprint("rx_file_remaining="); dbprint(rx_file_remaining);
-              dbprint(" bytesOut="); dbprintln(bytesOut);
-              next_millis = millis() + TIMEOUT_LONG;
-              rxmodem_state = BLOCKSTART;
-            }
-            else if (block == 0) {
-              // ymodem block 0 file name, file size, etc.
-              dbprint("rx file name (rx_buf)="); dbprintln((char *)rx_buf);
-              make_full_pathname((char*)rx_buf, rx_filename, sizeof(rx_filename)-1);
-              dbprint("rx dir name="); dbprintln((char *)rx_dirname);
-              dbprint("rx file name="); dbprintln((char *)rx_filename);
-              if (rx_buf[0] != '\0') {
-                fsptr->remove((char *)rx_filename);
-                rx_filename[sizeof(rx_filename)-1] = '\0';
-                rxmodem = fsptr->open(rx_filename, FILE_WRITE);
-                if (rxmodem) {
-                  rxmodem_state = BLOCKSTART;
-                  next_block = 1;
-                  reply = (CRC_on)? 'C' : NAK;
-                  port->write(reply);
-                  port->flush();
-                  next_millis = millis()+ TIMEOUT_LONG;
-                  dbprintln("rxmodem starting");
-                  dbprintln((char *)rx_buf + strlen((const char *)rx_buf)+1);
-                  rx_file_remaining = strtoul(
-                      (char *)&rx_buf[strlen((const char *)rx_buf)+1], NULL, 10);
-                  dbprint("rx_file_remaining=");
-                  dbprintln(rx_file_remaining);
-                }
-                else {
-                  dbprintln("rx file open failed");
-                }
-              }
-              else {
-                rxmodem_state = IDLE;
-              }
-            }
+        else if (inchar == ACK) {
+          tx_retries = 0;
+          if (!tx_block0) {
+            next_block++;
+            tx_data();
+          }
+          else if (tx_last) {
+            xytrace_state("sb done");
+            rxmodem_state = IDLE;
+          }
+          else {
+            // The receiver asks for the data with another 'C' or NAK.
+            next_block = 1;
+            rxmodem_state = SENDSTART;
+          }
+        }
+        else if (inchar == NAK || (inchar == 'C' && (tx_block0 || next_block == 1))) {
+          xytrace_error("block %u NAK", next_block);
+          if (++tx_retries > SEND_TRIES) {
+            reply = CAN;
+            send_reply();
+            rxmodem.close();
+            rxmodem_state = IDLE;
           }
           else {
-            dbprintln("Checksum bad");
-            port->write(NAK);
-            port->flush();
-            rxmodem_state = BLOCKSTART;
+            send_block();
           }
         }
         break;
-      case DATACHECKCRC:
-        CRCRx |= inchar;
-        dbprint("DATACHECK CRCRx=0x");
-        dbprintln(CRCRx, HEX);
-        if (CRCRx == CRC) {
-          dbprintln("CRC OK");
-          port->write(ACK);
-          port->flush();
-          if (block == next_block) {
-            dbprintln("Good block");
-            next_block++;
-            uint32_t bytesOut = min((uint32_t)blocksizenext, rx_file_remaining);
-            if(!YMODEM) bytesOut = blocksizenext; // with XMODEM transfer, expepcted length is unknown
-            rxmodem.write(rx_buf, bytesOut);
-            rx_file_remaining -= bytesOut;
-            dbprint("rx_file_remaining="); dbprint(rx_file_remaining);
-            dbprint(" bytesOut="); dbprintln(bytesOut);
-            next_millis = millis() + TIMEOUT_LONG;
-            rxmodem_state = BLOCKSTART;
+      case SENDEOT:
+        if ((inchar == ACK) && windowed && (tx_rnum != (uint8_t)(tx_blocks() + 1))) {
+          // A late ACK of a data block, not of the EOT.
+          break;
+        }
+        if (inchar == ACK) {
+          rxmodem.close();
+          xytrace_state("EOT acked <%s>", rx_filename);
+          if (YMODEM) {
+            next_block = 0;
+            rxmodem_state = SENDSTART;
+            next_millis = clock_ms() + TIMEOUT_SEND;
           }
-          else if (block == 0) {
-            // ymodem block 0 file name, file size, etc.
-            dbprint("rx file name (rx_buf)="); dbprintln((char *)rx_buf);
-            make_full_pathname((char*)rx_buf, rx_filename, sizeof(rx_filename)-1);
-            dbprint("rx dir name="); dbprintln((char *)rx_dirname);
-            dbprint("rx file name="); dbprintln((char *)rx_filename);
-            if (rx_buf[0] != '\0') {
-              fsptr->remove((char *)rx_filename);
-              rx_filename[sizeof(rx_filename)-1] = '\0';
-              rxmodem = fsptr->open(rx_filename, FILE_WRITE);
-              if (rxmodem) {
-                rxmodem_state = BLOCKSTART;
-                next_block = 1;
-                reply = (CRC_on)? 'C' : NAK;
-                port->write(reply);
-                port->flush();
-                next_millis = millis()+ TIMEOUT_LONG;
-                dbprintln("rxmodem starting");
-                dbprintln((char *)rx_buf + strlen((const char *)rx_buf)+1);
-                rx_file_remaining = strtoul(
-                    (char *)&rx_buf[strlen((const char *)rx_buf)+1], NULL, 10);
-                dbprint("rx_file_remaining=");
-                dbprintln(rx_file_remaining);
-              }
-              else {
-                dbprintln("rx file open failed");
-              }
-            }
-            else {
-              rxmodem_state = IDLE;
-            }
+          else {
+            rxmodem_state = IDLE;
           }
         }
-        else {
-          dbprintln("Checksum bad");
-          port->write(NAK);
+        else if (inchar == NAK || inchar == 'C') {
+          // lrzsz rb NAKs the first EOT to make sure it is not line noise.
+          // 'C' is a receiver that lost the EOT and timed out.
+          port->write(EOT);
           port->flush();
-          rxmodem_state = BLOCKSTART;
+          next_millis = clock_ms() + TIMEOUT_SEND;
         }
         break;
-      case DATAPURGE:
-        dbprintln("DATAPURGE");
-        int bytesAvail = port->available();
-        dbprint("bytesAvail=");
-        dbprintln(bytesAvail);
-        if (bytesAvail > 0) {
-          port->readBytes((char *)p, bytesAvail);
-        }
+      default:
         break;
     }
-  } // while available()
+  }
   return rxmodem_state;
 }
 
-inline uint16_t XYmodem::updcrc(uint8_t c, uint16_t crc)
+/*
+ * Windowed replies have more bytes: ACK and NAK the block number and its
+ * complement, W the window size as a digit. True if c starts one. The
+ * rest is read by tx_reply_byte().
+ */
+bool XYmodem::tx_reply_start(uint8_t c)
+{
+  if ((windowed && ((c == ACK) || (c == NAK))) ||
+      ((c == 'W') && (window > 0) && !windowed && (rxmodem_state == SENDSTART))) {
+    tx_reply = c;
+    tx_rlen = 1;
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Next byte of a windowed reply. True when the reply is complete and good,
+ * with the block number or window size in tx_rnum. A bad one is dropped,
+ * the timeouts recover.
+ */
+bool XYmodem::tx_reply_byte(uint8_t c)
 {
-  int count;
+  if (tx_reply == 'W') {
+    tx_rlen = 0;
+    tx_rnum = c - '0';
+    return (tx_rnum >= 1) && (tx_rnum <= 9);
+  }
+  if (tx_rlen == 1) {
+    tx_rnum = c;
+    tx_rlen = 2;
+    return false;
+  }
+  tx_rlen = 0;
+  return (uint8_t)(c ^ tx_rnum) == 0xFF;
+}
 
-  crc = crc ^ (uint16_t) c << 8;
-  count = 8;
-  do {
-    if (crc & 0x8000) {
-      crc = crc << 1 ^ 0x1021;
+/*
+ * ACK or NAK of a data block in windowed send. An ACK covers every block
+ * up to the one it names. A NAK names the first block the receiver does
+ * not have: send just that one again, and no new ones until it is ACKed.
+ * The ACK then covers the blocks after it the receiver kept. Those it did
+ * not keep are sent again from there.
+ */
+void XYmodem::tx_window_reply(uint8_t c)
+{
+  // Blocks from tx_base to the one named, 255 for one before tx_base.
+  uint8_t n = tx_rnum - (uint8_t)(tx_base + 1);
+
+  if (c == ACK) {
+    if (n >= tx_next - tx_base) return;
+    tx_base += n + 1;
+    tx_retries = 0;
+    next_millis = clock_ms() + TIMEOUT_SEND;
+    if (tx_resend) {
+      tx_resend = false;
+      tx_next = tx_base;
     }
-    else {
-      crc = crc << 1;
+    tx_fill();
+  }
+  else if (c == NAK) {
+    if (n > tx_next - tx_base) return;
+    tx_base += n;
+    if (tx_base == tx_next) {
+      // Nothing lost, the receiver wants the next block.
+      tx_fill();
+      return;
+    }
+    xytrace_error("block %u NAK", tx_rnum);
+    if (++tx_retries > SEND_TRIES) {
+      reply = CAN;
+      send_reply();
+      rxmodem.close();
+      rxmodem_state = IDLE;
+      return;
     }
-  } while (--count);
-  return crc;
+    tx_resend = true;
+    tx_send(tx_base);
+  }
 }
 
-int XYmodem::make_full_pathname(char *name, char *pathname, size_t pathname_len)
+/*
+ * Windowed send. Keep up to tx_window blocks in flight. EOT once all are
+ * ACKed.
+ */
+void XYmodem::tx_fill(void)
 {
-  if (name == NULL || name == '\0') return -1;
-  if (pathname == NULL || pathname_len == 0) return -1;
+  uint32_t end = tx_blocks();
 
-  // if dir name starts with '/', it is a full pathname so make it.
-  // else form full pathname with current working directory.
-  if (*name == '/') {
-    strncpy(pathname, name, pathname_len);
-    pathname[pathname_len-1] = '\0';
+  while (!tx_resend && (tx_next < end) && (tx_next - tx_base < tx_window)) {
+    if (!tx_send(tx_next)) return;
+    tx_next++;
   }
-  else {
-    strcpy(pathname, rx_dirname);
-    if (rx_dirname[strlen(rx_dirname)-1] == '/') {
-      if (strlen(rx_dirname) + strlen(name) >= pathname_len) {
-        port->println("pathname too long");
-        return -2;
-      }
+  if (tx_base == end) {
+    tx_eot();
+  }
+}
+
+/*
+ * Send block index of the file, counting from 0, in windowed send. A block
+ * sent again is read again, so the window needs no more than the one
+ * block buffer. Block sizes follow tx_data(): 1K while more than 896
+ * bytes are left, then 128.
+ */
+bool XYmodem::tx_send(uint32_t index)
+{
+  uint32_t n1k = tx_blocks_1k();
+  uint32_t at = (index < n1k) ? index * 1024 : n1k * 1024 + (index - n1k) * 128;
+  blocksize = (index < n1k) ? 1024 : 128;
+  uint32_t len = min((uint32_t)blocksize, tx_size - at);
+  int bytesIn = -1;
+  if ((rxmodem.position() == at) || rxmodem.seek(at)) {
+    bytesIn = rxmodem.read(rx_buf, len);
+  }
+  if (bytesIn != (int)len) {
+    xytrace_error("tx file read failed <%s>", rx_filename);
+    reply = CAN;
+    send_reply();
+    rxmodem.close();
+    rxmodem_state = IDLE;
+    return false;
+  }
+  if (len < blocksize) {
+    memset(rx_buf + len, 0x1A, blocksize - len);
+  }
+  next_block = index + 1;
+  xytrace_block("block %u bytesIn=%d", next_block, bytesIn);
+  send_block();
+  return true;
+}
+
+uint32_t XYmodem::tx_blocks_1k(void)
+{
+  return (tx_1k && (tx_size > 896)) ? (tx_size - 896 + 1023) / 1024 : 0;
+}
+
+uint32_t XYmodem::tx_blocks(void)
+{
+  uint32_t n1k = tx_blocks_1k();
+  uint32_t rest = (tx_size > n1k * 1024) ? tx_size - n1k * 1024 : 0;
+  return n1k + (rest + 127) / 128;
+}
+
+/*
+ * Build and send YMODEM block 0 for the next file in the batch: base name,
+ * NUL, length in decimal. An empty block 0 ends the batch.
+ */
+void XYmodem::tx_header(void)
+{
+  memset(rx_buf, 0, blk_buf_size);
+  tx_last = true;
+  while (tx_index < tx_count) {
+    const char *name = tx_files[tx_index++];
+    if (xy_full_pathname(rx_dirname, name, rx_filename, path_size-1) != 0) {
+      xytrace_error("tx pathname too long <%s>", name);
+      continue;
     }
-    else {
-      if (strlen(rx_dirname) + 1 + strlen(name) >= pathname_len) {
-        port->println("pathname too long");
-        return -2;
-      }
-      strcat(pathname, "/");
+    rxmodem = fsptr->open(rx_filename, FILE_READ);
+    if (!rxmodem || rxmodem.isDirectory()) {
+      xytrace_error("tx file open failed <%s>", rx_filename);
+      rxmodem.close();
+      continue;
+    }
+    rx_file_remaining = rxmodem.size();
+    tx_size = rx_file_remaining;
+    tx_base = tx_next = 0;
+    const char *base = strrchr(rx_filename, '/');
+    base = (base != NULL) ? base + 1 : rx_filename;
+    // Name, NUL, length and NUL must fit in a 1K block. MaxPath of a
+    // StaticXYmodem may be longer than that.
+    size_t room = min((size_t)blk_buf_size, (size_t)1024);
+    size_t len = strlen(base);
+    int n = -1;
+    if (len + 2 < room) {
+      memcpy(rx_buf, base, len);
+      n = snprintf((char *)&rx_buf[len+1], room - len - 1, "%lu",
+          (unsigned long)rx_file_remaining);
     }
-    strcat(pathname, name);
+    if ((n < 0) || (len + 1 + n + 1 > room)) {
+      xytrace_error("tx header does not fit <%s>", rx_filename);
+      reply = CAN;
+      send_reply();
+      rxmodem.close();
+      rxmodem_state = IDLE;
+      return;
+    }
+    xytrace_state("sb starting <%s> length=%lu", rx_filename,
+        (unsigned long)rx_file_remaining);
+    tx_last = false;
+    break;
   }
-  return 0;
+  blocksize = 128;
+  if (!tx_last && (strlen((char *)rx_buf) + 1 + strlen((char *)rx_buf +
+          strlen((char *)rx_buf) + 1) >= 128)) {
+    blocksize = 1024;
+  }
+  send_block();
+}
+
+/*
+ * Read the next block of the file straight into the block buffer and send
+ * it. 1K blocks are used while most of a 1K block would be file data. The
+ * last block is padded with ^Z. At end of file send EOT.
+ */
+void XYmodem::tx_data(void)
+{
+  if (rx_file_remaining == 0) {
+    tx_eot();
+    return;
+  }
+  blocksize = (tx_1k && (rx_file_remaining > 896)) ? 1024 : 128;
+  int bytesIn = rxmodem.read(rx_buf, min((uint32_t)blocksize, rx_file_remaining));
+  if (bytesIn <= 0) {
+    xytrace_error("tx file read failed <%s>", rx_filename);
+    reply = CAN;
+    send_reply();
+    rxmodem.close();
+    rxmodem_state = IDLE;
+    return;
+  }
+  if (bytesIn < blocksize) {
+    memset(rx_buf + bytesIn, 0x1A, blocksize - bytesIn);
+  }
+  rx_file_remaining -= bytesIn;
+  xytrace_block("block %u bytesIn=%d tx_file_remaining=%lu", next_block,
+      bytesIn, (unsigned long)rx_file_remaining);
+  send_block();
+}
+
+void XYmodem::tx_eot(void)
+{
+  port->write(EOT);
+  port->flush();
+  next_millis = clock_ms() + TIMEOUT_SEND;
+  rxmodem_state = SENDEOT;
+}
+
+/*
+ * Add the header and the checksum or CRC around the block in rx_buf and
+ * send it all with one write.
+ */
+void XYmodem::send_block(void)
+{
+  blk_buf[0] = (blocksize == 1024) ? STX : SOH;
+  blk_buf[1] = next_block;
+  blk_buf[2] = ~next_block;
+  if (CRC_on) {
+    uint16_t crc = XYcrc16::update(0, rx_buf, blocksize);
+    rx_buf[blocksize] = crc >> 8;
+    rx_buf[blocksize+1] = crc & 0xFF;
+  }
+  else {
+    uint8_t datachecksum = 0;
+    for (uint16_t i = 0; i < blocksize; i++) {
+      datachecksum += rx_buf[i];
+    }
+    rx_buf[blocksize] = datachecksum;
+  }
+  event(XYEV_SEND, blk_buf[0], next_block);
+  port->write(blk_buf, 3 + blocksize + ((CRC_on) ? 2 : 1));
+  port->flush();
+  next_millis = clock_ms() + TIMEOUT_SEND;
+  rxmodem_state = SENDBLOCK;
 }
 
+/*
+ * Send the reply character with whatever goes with it. CAN is sent twice,
+ * W is followed by the window size and a windowed NAK by the block number
+ * wanted.
+ */
+void XYmodem::send_reply(void)
+{
+  if (reply == NAK) stats.naks++;
+  event(XYEV_SEND, reply, next_block);
+  put(reply);
+  if (reply == CAN) {
+    put(CAN);
+  }
+  else if (reply == 'W') {
+    put('0' + window);
+  }
+  else if ((reply == NAK) && windowed) {
+    put(next_block);
+    put((uint8_t)~next_block);
+    nak_outstanding = true;
+  }
+  put_flush();
+}
+
+void XYmodem::send_ack(uint8_t block)
+{
+  ack_ms = clock_ms();
+  ack_timed = !streaming && !windowed;
+  event(XYEV_SEND, ACK, block);
+  put(ACK);
+  if (windowed) {
+    put(block);
+    put((uint8_t)~block);
+  }
+  put_flush();
+}
+
+void XYmodem::send_eot_ack(uint8_t block)
+{
+  put(ACK);
+  if (windowed) {
+    put(block);
+    put((uint8_t)~block);
+  }
+  put_flush();
+}
+
+void XYmodem::send_nak(void)
+{
+  uint8_t save = reply;
+  reply = NAK;
+  send_reply();
+  reply = save;
+}
 
 // TODO: move these out into the CPE-specific examples
 #if 0
@@ -113,6 +113,10 @@ extern Adafruit_W25Q16BV_FatFs fatfs;
 #endif
 
 #include <FS.h>
+#include "xyevent.h"
+#include "xysink.h"
+#include "xysha256.h"
+#include "xypath.h"
 
 #define SOH 0x01
 #define STX 0x02
@@ -131,41 +135,478 @@ class XYmodem {
       this->debugPort = debugPort;
     };
 
+    ~XYmodem() {
+      if (!static_buf) {
+        free(blk_buf);
+        free(rx_filename);
+        delete fsink;
+      }
+    };
+
+    // Owns its buffers, so a copy would free them twice.
+    XYmodem(const XYmodem &) = delete;
+    XYmodem &operator=(const XYmodem &) = delete;
+
     // TODO: not working as is, need to fix/remove and update arguments to new format
     int start_rx(Stream &port, FS &filesys, const char *rx_filename, bool rx_buf_1k, bool useCRC);
 
     // TODO: why not include port in constructor, instead of each start call?
-    int start_rb(Stream &port, FS &filesys, bool rx_buf_1k, bool useCRC);
-    int start_rb(Stream &port, FS &filesys, const char *rx_directory, bool rx_buf_1k, bool useCRC);
+    int start_rb(Stream &port, FS &filesys, bool rx_buf_1k, bool useCRC, bool streaming=false);
+    int start_rb(Stream &port, FS &filesys, const char *rx_directory, bool rx_buf_1k, bool useCRC, bool streaming=false);
+    // YMODEM receive without a port, for feed().
+    int start_rb(FS &filesys, const char *rx_directory, bool rx_buf_1k, bool useCRC, bool streaming=false);
+    // Receive into a sink instead of files on an FS, for example a RAM
+    // buffer or a parser. See xysink.h. sink must stay valid until the
+    // transfer ends. YMODEM file names are passed to the sink as pathnames
+    // under "/".
+    int start_rx(Stream &port, XYsink &sink, const char *rx_filename, bool rx_buf_1k, bool useCRC);
+    int start_rb(Stream &port, XYsink &sink, bool rx_buf_1k, bool useCRC, bool streaming=false);
+    int start_rb(XYsink &sink, bool rx_buf_1k, bool useCRC, bool streaming=false);
+
+    // Send one file using XMODEM. tx_filename is the full pathname.
+    int start_sx(Stream &port, FS &filesys, const char *tx_filename, bool tx_buf_1k);
+    // Send files using YMODEM batch mode. Names not starting with '/' are
+    // relative to tx_directory. tx_files must stay valid until loop()
+    // returns 0.
+    int start_sb(Stream &port, FS &filesys, const char *tx_directory,
+        const char * const *tx_files, uint8_t tx_count, bool tx_buf_1k);
     //int begin(void);
-    int loop(void);
+    // max_us limits the time spent in one call so the rest of the sketch
+    // keeps running under a fast sender. loop() stops at the first byte or
+    // block boundary after max_us and goes on from there next call. A block
+    // finished inside the budget is still written, so one file write can
+    // overrun it. 0 = until the port is empty.
+    int loop(uint32_t max_us=0);
+    // Work loop() has left: bytes waiting in the port plus data bytes
+    // queued for write-behind. 0 when nothing is waiting.
+    size_t pending(void);
+
+    // Push API for receive. Hand the engine bytes as they arrive, for
+    // example from a USB receive callback, a DMA complete interrupt or a
+    // socket, instead of letting loop() poll a Stream. A whole block found
+    // in data is checked and written from there without a copy. Returns the
+    // number of reply bytes put in reply, at most reply_size, for the
+    // caller to send. Replies that do not fit come out of the next call.
+    // After start_rb without a port, call feed() instead of loop(), with
+    // len 0 when nothing arrived so timeouts still run. With a port the
+    // replies go to the port and feed() returns 0. Replies are put straight
+    // into reply. Only a few bytes that do not fit are held for the next
+    // call, so give it REPLY_MAX bytes. Bytes past those are lost and
+    // counted in getStats().reply_overflows.
+    static const uint8_t REPLY_MAX = 32;
+    size_t feed(const uint8_t *data, size_t len, uint8_t *reply, size_t reply_size);
+    // False once the transfer is over.
+    bool active(void) { return rxmodem_state != IDLE; };
+
+    // Windowed mode for high latency links. Up to blocks (1..9) blocks
+    // may be in flight. ACK and NAK carry the block number, an ACK covers
+    // every block up to it. The receiver asks with 'W' and falls back to
+    // classic XMODEM/YMODEM if the sender does not answer. A sender answers
+    // 'W' only when its window is set, and uses the smaller of the two.
+    // With write-behind the receiver keeps blocks that arrive after a lost
+    // one and only the lost one is sent again, otherwise the sender goes
+    // back to it. Needs CRC. Call before start_rx/start_rb/start_sx/start_sb.
+    // 0 = off.
+    void setWindow(uint8_t blocks) {
+      this->window = (blocks > 9) ? 9 : blocks;
+    };
+
+    // Write-behind. Good blocks are queued in pool and written to the file
+    // later so reception goes on while the file system is busy, for example
+    // during an SD erase. The ACK for a block is held back while the pool is
+    // full. pool is split into a power of 2 number of slots of one block
+    // each, at least 2. With external_drain the application calls drain()
+    // from another core or task, otherwise loop() writes one block per call.
+    // While it waits for external drain() calls the receiver calls yield(),
+    // so a drain task on the same core gets to run. Call before
+    // start_rx/start_rb. pool NULL = off.
+    void setWriteBehind(uint8_t *pool, size_t pool_len, bool external_drain=false) {
+      this->pool = pool;
+      this->pool_len = (pool != NULL) ? pool_len : 0;
+      this->drain_external = external_drain;
+    };
+    // Write the oldest queued block to the file. Returns the number of
+    // blocks still queued. The only call allowed from the consumer side.
+    int drain(void);
+
+    // Write coalescing. Received data is gathered in buf and written to the
+    // file len bytes at a time at offsets that are multiples of len, so FAT
+    // on SPI flash does no read-modify-write. Use the sector (512) or erase
+    // block (4096) size. The rest is written at EOT. Call before
+    // start_rx/start_rb. buf NULL = off.
+    void setWriteCoalescing(uint8_t *buf, uint16_t len) {
+      this->co_buf = (len != 0) ? buf : NULL;
+      this->co_size = len;
+    };
+    // FS write calls saved by coalescing since start_rx/start_rb. Negative
+    // if the chunk is smaller than the blocks received.
+    int32_t writesSaved(void) { return (int32_t)(block_writes - file_writes); };
+
+    // Read-back verification. When a file is complete it is read back from
+    // the sink len bytes at a time into buf and its CRC-32 compared with
+    // the one of the data written. A mismatch cancels the transfer instead
+    // of ACKing the EOT. The coalescing buffer may be used, it is empty by
+    // then. Sinks that cannot read back are not checked. buf NULL = off.
+    void setVerify(uint8_t *buf, uint16_t len) {
+      this->verify_buf = (len != 0) ? buf : NULL;
+      this->verify_len = len;
+    };
+    // Keep a SHA-256 of each received file in sha as well as the CRC-32.
+    // The caller owns it, about 110 bytes. Call before start_rx/start_rb.
+    // NULL = off.
+    void setSha256(XYsha256 *sha) {
+      this->file_sha = sha;
+    };
+    // SHA-256 of the last file closed. False if setSha256() is off.
+    bool fileSha256(uint8_t digest[XYsha256::DIGEST_SIZE]);
+
+    // YMODEM block 0 gives the file length before any data arrives. If the
+    // file does not fit in the free space of the file system the transfer
+    // is cancelled at once. Free space comes from totalSize() - usedSize(),
+    // which scans the FAT on some cards, so it can be turned off.
+    // Applies to receiving into files, not into other sinks.
+    void setSpaceCheck(bool on) {
+      if (file_sink() != NULL) fsink->setSpaceCheck(on);
+    };
+    // Called with the new, empty file and its length from block 0. Use it to
+    // reserve contiguous clusters, for example with SdFat preAllocate(), so
+    // the FAT chain is not extended on every block write. Return false to
+    // refuse the file, which cancels the transfer. NULL = none.
+    typedef XYfileSink::prealloc_func_t prealloc_func_t;
+    void setPreallocate(prealloc_func_t prealloc) {
+      if (file_sink() != NULL) fsink->setPreallocate(prealloc);
+    };
+
+    // Receive timeouts. The receiver measures the time from each ACK to the
+    // reply from the sender and how long a block takes to arrive, and sets
+    // its timeouts from the mean and deviation of these the way TCP sets
+    // its RTO. They are kept between min_ms and max_ms. Until the first
+    // measurements, and with adaptive false, the fixed 3 s wait for a block
+    // and 1 s gap inside a block are used, also kept between min_ms and
+    // max_ms. The default min_ms of 1000 is safe with senders that take a
+    // NAK sent while they are still sending as a bad block. Lower it for a
+    // sender known to cope, on USB for example. Call before
+    // start_rx/start_rb.
+    void setTimeoutPolicy(uint32_t min_ms, uint32_t max_ms, bool adaptive=true) {
+      this->tmo_min = min_ms;
+      this->tmo_max = (max_ms >= min_ms) ? max_ms : min_ms;
+      this->tmo_adaptive = adaptive;
+    };
+
+    // Receive statistics since start_rx/start_rb. The file_ fields are for
+    // the last file closed.
+    typedef struct {
+      uint32_t bytes;           // data bytes written to files
+      uint32_t blocks;          // blocks accepted
+      uint32_t duplicates;      // repeats of blocks already accepted
+      uint32_t naks;            // NAKs sent
+      uint32_t bad_checks;      // CRC or checksum failures
+      uint32_t timeouts;
+      uint32_t files;           // files closed
+      uint32_t file_bytes;
+      uint32_t file_ms;         // open to close wall time
+      uint32_t file_bytes_per_s;
+      uint32_t file_crc32;      // CRC-32 (zlib crc32()) of the data written
+      uint32_t write_errors;    // short writes, each cancels the transfer
+      uint32_t verified;        // files read back and matching
+      uint32_t verify_errors;   // files read back and not matching
+      uint32_t reply_overflows; // feed() reply bytes lost, reply_size too small
+    } stats_t;
+    const stats_t &getStats(void) { return stats; };
+    // Called when a file is closed and when the session ends.
+    typedef void (*stats_func_t)(const stats_t &stats, bool session_end);
+    void setStatsCallback(stats_func_t stats_cb) {
+      this->stats_cb = stats_cb;
+    };
+    // Log2 histograms in microseconds. Bin 0 counts 0 us, bin n counts
+    // 2^(n-1) to 2^n - 1 us, the last bin everything longer.
+    static const uint8_t HIST_BINS = 24;
+    typedef struct {
+      uint32_t interarrival[HIST_BINS];  // between accepted blocks
+      uint32_t write[HIST_BINS];         // sink write latency
+    } hist_t;
+    // Fill hist, which the caller owns, cleared at start_rx/start_rb.
+    // NULL = off.
+    void setHistograms(hist_t *hist) {
+      this->hist = hist;
+    };
+
+    // Binary event trace into buf, count events, rounded down to a power
+    // of 2. The oldest events are overwritten. See xyevent.h. NULL = off.
+    void setEventTrace(xyevent_t *buf, uint16_t count) {
+      while (count & (count - 1)) count &= count - 1;
+      this->ev_buf = (count != 0) ? buf : NULL;
+      this->ev_mask = count - 1;
+      this->ev_total = 0;
+    };
+    // Write the recorded events oldest first as hex text lines for
+    // xyevent.py.
+    void dumpEvents(Print &out);
+
+    // Time source in milliseconds and microseconds. Defaults to millis()
+    // and micros(). Replace them to run the engine against a simulated
+    // clock, for example on a host build.
+    typedef uint32_t (*clock_func_t)(void);
+    void setClock(clock_func_t clock_ms, clock_func_t clock_us=NULL) {
+      this->clock_ms = (clock_ms != NULL) ? clock_ms : default_clock;
+      this->clock_us = (clock_us != NULL) ? clock_us : default_clock_us;
+    };
+
+    // RAM used by this object, including its heap buffers.
+    size_t footprint(void);
+
+  protected:
+    void setStorage(uint8_t *blk, uint16_t max_block, char *paths,
+        uint16_t path_size, XYfileSink *files, size_t obj_size);
   private:
     const uint32_t TIMEOUT_LONG=3000;
     const uint32_t TIMEOUT_SHORT=1000;
+    const uint8_t WINDOW_TRIES=3;
+    const uint32_t TIMEOUT_GAP=50;     // line quiet after garbage, reply now
+    const uint32_t TIMEOUT_SEND=6000;
+    const uint8_t SEND_TRIES=10;
     File rxmodem;
     enum rxmodem_t {
-      IDLE, BLOCKSTART, BLOCKNUM, BLOCKCHECK, DATABLOCK,
-      DATACHECK, DATACHECKCRC, DATAPURGE
+      IDLE, BLOCKSTART, BLOCKNUM, BLOCKCHECK, DATABLOCK, RESYNC,
+      SENDSTART, SENDBLOCK, SENDEOT
     };
     rxmodem_t rxmodem_state = IDLE;
-    char rx_filename[128+1];
-    char rx_dirname[128+1];
+    char *rx_filename = NULL;
+    char *rx_dirname = NULL;
+    uint16_t path_size = 128+1;
+    bool static_buf = false;  // storage from setStorage(), no heap
+    size_t obj_size = sizeof(XYmodem);
     uint8_t next_block;
-    uint8_t *rx_buf = NULL;
+    uint8_t *blk_buf = NULL;  // block header, data, checksum or CRC
+    uint16_t blk_buf_size = 0;
+    uint8_t *rx_buf = NULL;   // data part of blk_buf
     uint16_t rx_buf_size = 128;
+    uint16_t blocksize;
+    uint8_t rx_block;         // block number of the block being received
+    uint8_t *rx_p;            // where its next byte goes
+    uint16_t rx_bytesleft;    // bytes of it still to come
     uint32_t rx_file_remaining;
     uint32_t next_millis = 0;
     uint8_t reply;
     bool CRC_on = false;
     bool YMODEM = false;
-    Stream *port;
+    bool streaming = false;   // YMODEM-G
+    uint8_t window = 0;       // windowed mode requested, max blocks in flight
+    bool windowed = false;    // windowed mode accepted by the sender
+    bool wreq_pending = false;
+    uint8_t wreq_tries;
+    uint8_t hdr_win[3];       // last 3 bytes seen while resynchronising
+    bool nak_outstanding;
+    uint16_t ahead_mask;      // bit n: block next_block+n kept in a pool slot
+    bool rx_ahead;            // the block coming in goes to one of those slots
+    uint8_t *pool = NULL;
+    size_t pool_len = 0;
+    uint16_t pool_slot_size;
+    uint8_t pool_slots = 0;   // 0 = write-behind off
+    // Single producer (loop) single consumer (drain) queue. Free running
+    // 8 bit counters so each side updates its own index atomically.
+    volatile uint8_t pool_head = 0;
+    volatile uint8_t pool_tail = 0;
+    bool drain_external = false;
+    bool ack_pending;         // ACK for ack_block held until a slot is free
+    uint8_t ack_block;
+    bool eot_pending;         // EOT held until the queue is written
+    uint8_t *co_buf = NULL;   // write coalescing buffer
+    uint16_t co_size = 0;
+    uint16_t co_used;
+    uint32_t block_writes;    // blocks handed to file_write()
+    uint32_t file_writes;     // File::write calls made for them
+    // Smoothed round trip (reply to first byte back) and block time
+    typedef struct {
+      uint32_t srtt;
+      uint32_t rttvar;
+      bool valid;
+    } rtt_est_t;
+    rtt_est_t rtt_est;
+    rtt_est_t blk_est;
+    uint32_t tmo_min = 1000;
+    uint32_t tmo_max = 10000;
+    bool tmo_adaptive = true;
+    uint8_t rto_backoff;      // doublings of the block wait after timeouts
+    uint32_t ack_ms;          // when the last ACK went out
+    bool ack_timed;           // no timeout since, so a sample is valid
+    uint32_t blk_ms;          // when the header of this block started
+    bool blk_timed;
+    stats_t stats;
+    stats_func_t stats_cb = NULL;
+    hist_t *hist = NULL;
+    uint32_t file_start_ms;
+    uint32_t last_block_us;
+    bool last_block_valid;
+    uint32_t file_crc;        // rolling CRC-32 of the file being written
+    XYsha256 *file_sha = NULL;
+    uint8_t *verify_buf = NULL;
+    uint16_t verify_len = 0;
+    volatile bool write_failed;  // set by drain() on a short write
+    xyevent_t *ev_buf = NULL;
+    uint16_t ev_mask;
+    uint32_t ev_total;        // events recorded, including overwritten ones
+    uint8_t ev_state = IDLE;  // last state recorded
+    XYsink *sink;             // where received data goes
+    XYfileSink *fsink = NULL; // the sink for start_rx/start_rb with an FS
+    bool rx_open = false;     // sink has a file begun and not ended
+    const char * const *tx_files;
+    uint8_t tx_count;
+    uint8_t tx_index;
+    bool tx_1k;
+    bool tx_block0;           // the block in flight is YMODEM block 0
+    bool tx_last;             // the block 0 in flight ends the batch
+    uint8_t tx_retries;
+    uint8_t tx_window;        // windowed send: blocks in flight
+    uint32_t tx_size;         // windowed send: file length
+    uint32_t tx_base;         // index in the file of the oldest block not ACKed
+    uint32_t tx_next;         // index of the next block to send
+    bool tx_resend;           // a NAKed block went again, no new ones until ACKed
+    uint8_t tx_reply;         // windowed reply being read: ACK, NAK or W
+    uint8_t tx_rnum;          // its block number or window size
+    uint8_t tx_rlen;          // bytes of it read, 0 = none
+    uint8_t cancount;
+    static const uint8_t REPLY_HELD = 8;
+    uint8_t *reply_buf = NULL;  // the caller's buffer during feed()
+    size_t reply_cap = 0;
+    size_t reply_len = 0;
+    uint8_t held[REPLY_HELD];   // replies that did not fit, for next feed()
+    uint8_t held_len = 0;
+    Stream *port;             // NULL when fed with feed()
     Stream *debugPort;
     FS *fsptr;
+    clock_func_t clock_ms = default_clock;
+    clock_func_t clock_us = default_clock_us;
+
+  private:
+    int start(Stream *port, FS *filesys, XYsink *sink, const char *rx_filename, bool rx_buf_1k, bool useCRC);
+    int start_send(Stream *port, FS *filesys, bool tx_buf_1k);
+    int alloc_buf(uint16_t size);
+    int rx_loop(uint32_t max_us);
+    void rx_pool(void);
+    bool rx_timeout(void);
+    void rx_byte(uint8_t inchar);
+    void put(uint8_t c) {
+      if (port != NULL) port->write(c);
+      else if ((held_len == 0) && (reply_len < reply_cap)) reply_buf[reply_len++] = c;
+      else if (held_len < REPLY_HELD) held[held_len++] = c;
+      else stats.reply_overflows++;
+    }
+    void put_flush(void) {
+      if (port != NULL) port->flush();
+    }
+    int tx_loop(void);
+    void tx_header(void);
+    void tx_data(void);
+    void tx_eot(void);
+    bool tx_reply_start(uint8_t c);
+    bool tx_reply_byte(uint8_t c);
+    void tx_window_reply(uint8_t c);
+    void tx_fill(void);
+    bool tx_send(uint32_t index);
+    uint32_t tx_blocks_1k(void);
+    uint32_t tx_blocks(void);
+    void send_block(void);
+    void rtt_sample(rtt_est_t &est, uint32_t ms);
+    uint32_t rto(const rtt_est_t &est, uint32_t initial, uint8_t backoff=0);
+    uint32_t timeout_long(void) { return rto(rtt_est, TIMEOUT_LONG, rto_backoff); }
+    uint32_t timeout_short(void) { return rto(blk_est, TIMEOUT_SHORT); }
+    bool timed_out(void) { return (int32_t)(clock_ms() - next_millis) > 0; }
+    bool block_expected(uint8_t block);
+    void block_start(void);
+    void resync(uint8_t b1, uint8_t b2);
+    void block_received(uint8_t block, const uint8_t *blk);
+    void eot_received(void);
+    void file_write(const uint8_t *data, size_t len);
+    void sink_write(const uint8_t *data, size_t len);
+    void file_opened(void);
+    static void hist_add(uint32_t *hist, uint32_t us);
+    void event(uint8_t type, uint8_t a, uint16_t b=0) {
+      if (ev_buf != NULL) {
+        xyevent_t *e = &ev_buf[ev_total++ & ev_mask];
+        e->us = clock_us();
+        e->type = type;
+        e->a = a;
+        e->b = b;
+      }
+    }
+    void event_state(void) {
+      if ((ev_buf != NULL) && (rxmodem_state != ev_state)) {
+        ev_state = rxmodem_state;
+        event(XYEV_STATE, ev_state);
+      }
+    }
+    bool file_close(void);
+    bool verify(void);
+    bool write_check(void);
+    uint8_t *pool_slot(uint8_t n) {
+      return pool + (uint16_t)(n & (pool_slots - 1)) * pool_slot_size;
+    }
+    uint8_t pool_count(void) { return (uint8_t)(pool_head - pool_tail); }
+    void pool_flush(void);
+    // Character that asks the sender to start (or restart) sending.
+    uint8_t start_char(void) {
+      return (streaming) ? 'G' : (wreq_pending) ? 'W' : (CRC_on) ? 'C' : NAK;
+    }
+    // Reply to a bad block. YMODEM-G cannot retransmit so it cancels.
+    uint8_t nak_char(void) { return (streaming) ? CAN : NAK; }
+    void send_reply(void);
+    void send_ack(uint8_t block);
+    void send_eot_ack(uint8_t block);
+    void send_nak(void);
+    // The file sink, allocated on first use unless the storage is static.
+    XYfileSink *file_sink(void) {
+      if ((fsink == NULL) && !static_buf) fsink = new XYfileSink();
+      return fsink;
+    }
+    static uint32_t default_clock(void) { return millis(); }
+    static uint32_t default_clock_us(void) { return micros(); }
+};
+
+/*
+ * Storage for the file sink of StaticXYmodem, or none.
+ */
+template <bool Files>
+class XYfileSinkStorage {
+  protected:
+    XYfileSink *file_sink_storage(void) { return &files; };
+  private:
+    XYfileSink files;
+};
+
+template <>
+class XYfileSinkStorage<false> {
+  protected:
+    XYfileSink *file_sink_storage(void) { return NULL; };
+};
+
+/*
+ * XYmodem with its buffers inside the object, sized at compile time, and
+ * no heap use. MaxBlock is 128 or 1024, MaxPath the longest path name.
+ * Starting a transfer with bigger blocks than MaxBlock fails. Files false
+ * leaves out the file sink, for receiving only into other sinks; starting
+ * with an FS then fails. The whole RAM cost is sizeof() of the object,
+ * also returned by footprint().
+ *
+ *    StaticXYmodem<1024, 64> rxymodem;
+ *    StaticXYmodem<1024, 64, false> rawrx;   // sinks only
+ */
+template <uint16_t MaxBlock, uint16_t MaxPath, bool Files=true>
+class StaticXYmodem : public XYmodem, private XYfileSinkStorage<Files> {
+  public:
+    StaticXYmodem() {
+      setStorage(blk, MaxBlock, paths, MaxPath + 1,
+          this->file_sink_storage(), sizeof(*this));
+    };
+
+    StaticXYmodem(Stream *debugPort) : XYmodem(debugPort) {
+      setStorage(blk, MaxBlock, paths, MaxPath + 1,
+          this->file_sink_storage(), sizeof(*this));
+    };
 
   private:
-    int start(Stream *port, FS *filesys, const char *rx_filename, bool rx_buf_1k, bool useCRC);
-    uint16_t updcrc(uint8_t c, uint16_t crc);
-    int make_full_pathname(char *name, char *pathname, size_t pathname_len);
+    uint8_t blk[3 + MaxBlock + 2];
+    char paths[2 * (MaxPath + 1)];
 };
 
 #endif /* _XYMODEM_H_ */
@@ -0,0 +1,191 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _XYNOISE_H_
+#define _XYNOISE_H_
+
+#include <Arduino.h>
+
+/*
+ * Noisy channel simulator. Wraps the Stream XYmodem receives from and
+ * injects faults with a seeded pseudo random generator, so the same seed
+ * gives the same fault pattern every run.
+ *
+ *    XYnoisyStream noisy(Serial, 1234);
+ *    noisy.bitflip_ppm = 100;
+ *    rxymodem.start_rb(noisy, SD, true, true);
+ *
+ * Faults on bytes read from the sender:
+ *    bitflip_ppm   flip one random bit of a byte
+ *    drop_ppm      lose a byte
+ *    trunc_ppm     lose the 2 bytes after a SOH or STX (truncated header)
+ *    stall_ppm     stop delivering bytes for stall_ms (line delay)
+ * Faults on replies written to the sender:
+ *    ackdrop_ppm   lose an ACK reply so the sender repeats the block
+ *                  (duplicates)
+ *
+ * Rates are in parts per million per byte, ackdrop_ppm per ACK. counts
+ * holds the number of faults injected of each kind. A reply is what is
+ * written between two flush() calls, which is how XYmodem sends them, and
+ * only one starting with ACK is dropped, all of it, so block numbers and
+ * data that happen to be 0x06 are left alone. Stalls are timed with
+ * millis(), or the clock given to setClock(), which should be the one
+ * given to XYmodem.
+ */
+class XYnoisyStream : public Stream {
+  public:
+    XYnoisyStream(Stream &port, uint32_t seed) {
+      this->port = &port;
+      this->seed = (seed != 0) ? seed : 1;
+    };
+
+    typedef uint32_t (*clock_func_t)(void);
+    void setClock(clock_func_t clock_ms) {
+      this->clock_ms = (clock_ms != NULL) ? clock_ms : default_clock;
+    };
+
+    uint32_t bitflip_ppm = 0;
+    uint32_t drop_ppm = 0;
+    uint32_t trunc_ppm = 0;
+    uint32_t stall_ppm = 0;
+    uint32_t stall_ms = 100;
+    uint32_t ackdrop_ppm = 0;
+
+    struct {
+      uint32_t bytes;
+      uint32_t bitflips;
+      uint32_t drops;
+      uint32_t truncs;
+      uint32_t stalls;
+      uint32_t ackdrops;
+    } counts = {0, 0, 0, 0, 0, 0};
+
+    int available(void) {
+      fill();
+      return ring_count;
+    };
+
+    int read(void) {
+      fill();
+      if (ring_count == 0) return -1;
+      uint8_t c = ring[ring_head];
+      ring_head = (ring_head + 1) % sizeof(ring);
+      ring_count--;
+      return c;
+    };
+
+    int peek(void) {
+      fill();
+      if (ring_count == 0) return -1;
+      return ring[ring_head];
+    };
+
+    size_t write(uint8_t c) {
+      if (reply_start) {
+        reply_start = false;
+        reply_lost = (c == 0x06) && chance(ackdrop_ppm);
+        if (reply_lost) counts.ackdrops++;
+      }
+      if (reply_lost) return 1;
+      return port->write(c);
+    };
+
+    size_t write(const uint8_t *buf, size_t len) {
+      for (size_t i = 0; i < len; i++) write(buf[i]);
+      return len;
+    };
+    using Print::write;
+
+    void flush(void) {
+      reply_start = true;
+      if (!reply_lost) port->flush();
+      reply_lost = false;
+    };
+
+  private:
+    Stream *port;
+    uint32_t seed;
+    uint8_t ring[64];
+    uint8_t ring_head = 0;
+    uint8_t ring_count = 0;
+    uint8_t skip = 0;
+    bool stalled = false;
+    uint32_t stall_end;
+    bool reply_start = true;  // next byte written starts a reply
+    bool reply_lost = false;  // the reply being written is dropped
+    clock_func_t clock_ms = default_clock;
+
+    static uint32_t default_clock(void) { return millis(); }
+
+    // xorshift32
+    uint32_t random32(void) {
+      seed ^= seed << 13;
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+      return seed;
+    };
+
+    bool chance(uint32_t ppm) {
+      return (ppm != 0) && ((random32() % 1000000UL) < ppm);
+    };
+
+    // Move bytes from the real port into the ring, injecting faults.
+    void fill(void) {
+      if (stalled) {
+        if ((int32_t)(clock_ms() - stall_end) < 0) return;
+        stalled = false;
+      }
+      while ((ring_count < sizeof(ring)) && (port->available() > 0)) {
+        int c = port->read();
+        if (c < 0) break;
+        counts.bytes++;
+        if (skip > 0) {
+          skip--;
+          continue;
+        }
+        if (chance(drop_ppm)) {
+          counts.drops++;
+          continue;
+        }
+        if (chance(bitflip_ppm)) {
+          counts.bitflips++;
+          c ^= 1 << (random32() & 7);
+        }
+        if ((c == 0x01 || c == 0x02) && chance(trunc_ppm)) {
+          counts.truncs++;
+          skip = 2;
+        }
+        ring[(ring_head + ring_count) % sizeof(ring)] = (uint8_t)c;
+        ring_count++;
+        if (chance(stall_ppm)) {
+          counts.stalls++;
+          stalled = true;
+          stall_end = clock_ms() + stall_ms;
+          return;
+        }
+      }
+    };
+};
+
+#endif /* _XYNOISE_H_ */
@@ -0,0 +1,48 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <string.h>
+#include <xypath.h>
+
+int xy_full_pathname(const char *dir, const char *name, char *pathname,
+    size_t pathname_len)
+{
+  if (name == NULL || *name == '\0') return -1;
+  if (pathname == NULL || pathname_len == 0) return -1;
+
+  size_t namelen = strlen(name);
+  if (*name == '/') {
+    if (namelen >= pathname_len) return -2;
+    memcpy(pathname, name, namelen + 1);
+    return 0;
+  }
+  size_t dirlen = (dir != NULL) ? strlen(dir) : 0;
+  bool slash = (dirlen > 0) && (dir[dirlen-1] == '/');
+  if (dirlen + ((slash) ? 0 : 1) + namelen >= pathname_len) return -2;
+  if (dirlen > 0) memcpy(pathname, dir, dirlen);
+  if (!slash) pathname[dirlen++] = '/';
+  memcpy(pathname + dirlen, name, namelen + 1);
+  return 0;
+}
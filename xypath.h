@@ -0,0 +1,43 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef _XYPATH_H_
+#define _XYPATH_H_
+
+#include <stddef.h>
+
+/*
+ * Full pathname of name in directory dir, as the receivers and
+ * SerialFileBrowser make them. A name starting with '/' is taken as it is.
+ * Otherwise it is joined to dir with a '/' unless dir already ends in one.
+ * An empty dir is the root directory.
+ *
+ * Returns 0, -1 if name is empty or there is no pathname buffer, -2 if the
+ * pathname with its '\0' does not fit in pathname_len bytes.
+ */
+int xy_full_pathname(const char *dir, const char *name, char *pathname,
+    size_t pathname_len);
+
+#endif /* _XYPATH_H_ */
@@ -0,0 +1,55 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef _XYSHA256_H_
+#define _XYSHA256_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * SHA-256 for checking received files against sha256sum on the host.
+ * Incremental: begin(), update() as the data comes, finish().
+ */
+class XYsha256 {
+  public:
+    static const uint8_t DIGEST_SIZE = 32;
+
+    XYsha256() { begin(); };
+
+    void begin(void);
+    void update(const uint8_t *data, size_t len);
+    void finish(uint8_t digest[DIGEST_SIZE]);
+
+  private:
+    uint32_t h[8];
+    uint8_t block[64];
+    uint8_t used;             // bytes in block
+    uint64_t total;           // bytes hashed
+
+    void compress(const uint8_t *p);
+};
+
+#endif /* _XYSHA256_H_ */
@@ -0,0 +1,142 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <Arduino.h>
+#include <xysink.h>
+#include <xytrace.h>
+
+/*
+ * The free space is checked before the old file is touched, so a file that
+ * is refused leaves the old one in place. The old file is only removed
+ * once the new one fits.
+ */
+bool XYfileSink::begin_file(const char *name, uint32_t length)
+{
+  if (fsptr == NULL) return false;
+  if ((length != UNKNOWN_LENGTH) && !space_for(name, length)) return false;
+  fsptr->remove((char *)name);
+  file = fsptr->open(name, FILE_WRITE);
+  if (!file) {
+    xytrace_error("rx file open failed <%s>", name);
+    return false;
+  }
+  if ((length != UNKNOWN_LENGTH) && (prealloc != NULL) &&
+      !prealloc(file, length)) {
+    // Refuse now rather than fail half way through the file.
+    xytrace_error("preallocate failed <%s>", name);
+    file.close();
+    fsptr->remove((char *)name);
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Check the length against the free space. The old file of the same name
+ * is replaced, so its size counts as free.
+ */
+bool XYfileSink::space_for(const char *name, uint32_t length)
+{
+  if (!space_check) return true;
+  uint64_t total = fsptr->totalSize();
+  uint64_t used = fsptr->usedSize();
+  if ((total == 0) || (used > total)) return true;
+  uint64_t avail = total - used;
+  if (fsptr->exists(name)) {
+    File old = fsptr->open(name, FILE_READ);
+    if (old) {
+      if (!old.isDirectory()) avail += old.size();
+      old.close();
+    }
+  }
+  if (length > avail) {
+    xytrace_error("no space for <%s> length=%lu free=%lu", name,
+        (unsigned long)length, (unsigned long)avail);
+    return false;
+  }
+  return true;
+}
+
+size_t XYfileSink::write(const uint8_t *data, size_t len)
+{
+  return file.write(data, len);
+}
+
+bool XYfileSink::end_file(void)
+{
+  file.close();
+  return true;
+}
+
+void XYfileSink::cancel_file(const char *name)
+{
+  file.close();
+  if (fsptr != NULL) fsptr->remove((char *)name);
+}
+
+int XYfileSink::read(uint32_t pos, uint8_t *data, size_t len)
+{
+  if (pos == 0) file.flush();
+  if (!file.seek(pos)) return -1;
+  int n = file.read(data, len);
+  return (n >= 0) ? n : -1;
+}
+
+bool XYramSink::begin_file(const char *name, uint32_t length)
+{
+  (void)name;
+  used = 0;
+  done = false;
+  return (length == UNKNOWN_LENGTH) || (length <= size);
+}
+
+size_t XYramSink::write(const uint8_t *data, size_t len)
+{
+  size_t n = min(len, size - used);
+  memcpy(buf + used, data, n);
+  used += n;
+  return n;
+}
+
+bool XYramSink::end_file(void)
+{
+  done = true;
+  return true;
+}
+
+void XYramSink::cancel_file(const char *name)
+{
+  (void)name;
+  used = 0;
+  done = false;
+}
+
+int XYramSink::read(uint32_t pos, uint8_t *data, size_t len)
+{
+  if (pos >= used) return 0;
+  if (len > used - pos) len = used - pos;
+  memcpy(data, buf + pos, len);
+  return len;
+}
@@ -0,0 +1,188 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef _XYSINK_H_
+#define _XYSINK_H_
+
+#include <FS.h>
+
+/*
+ * Where received data goes. XYmodem calls begin_file() when a file starts,
+ * write() with the data in order, and end_file() at EOT or when the
+ * transfer is cancelled. The data pointer is only valid during the call.
+ * A short write() cancels the transfer. So does end_file() returning false,
+ * after which cancel_file() throws the file away.
+ *
+ * XYfileSink writes files to an FS and is what start_rb/start_rx with an FS
+ * use. XYramSink and XYcallbackSink hand the data to a RAM buffer or a
+ * function without a file system. Derive from XYsink for anything else.
+ */
+class XYsink {
+  public:
+    virtual ~XYsink() {};
+
+    // YMODEM block 0 had no length, or XMODEM.
+    static const uint32_t UNKNOWN_LENGTH = 0xFFFFFFFF;
+
+    // name is the full pathname. Return false to refuse the file, which
+    // cancels the transfer.
+    virtual bool begin_file(const char *name, uint32_t length) = 0;
+    // Returns the number of bytes taken.
+    virtual size_t write(const uint8_t *data, size_t len) = 0;
+    // Return false if the file is bad, for example cut short.
+    virtual bool end_file(void) = 0;
+    // Remove what was written of the file name given to begin_file(),
+    // after end_file() returned false.
+    virtual void cancel_file(const char *name) { (void)name; };
+    // True if read() can read back the file being written.
+    virtual bool readable(void) { return false; };
+    // Read back the file being written, before end_file(), to verify it.
+    // Returns the bytes read, 0 at the end, or -1 if the read failed.
+    virtual int read(uint32_t pos, uint8_t *data, size_t len) {
+      (void)pos;
+      (void)data;
+      (void)len;
+      return -1;
+    };
+};
+
+/*
+ * Files on an FS. A file of the same name is replaced. With a known length
+ * the free space, counting the old file as free, is checked before the old
+ * file is removed, and the preallocate hook, if any, is called on the new
+ * file before any data arrives.
+ */
+class XYfileSink : public XYsink {
+  public:
+    XYfileSink() {
+      this->fsptr = NULL;
+      this->debugPort = NULL;
+    };
+
+    XYfileSink(FS &filesys, Stream *debugPort=NULL) {
+      attach(&filesys, debugPort);
+    };
+
+    void attach(FS *filesys, Stream *debugPort=NULL) {
+      this->fsptr = filesys;
+      this->debugPort = debugPort;
+    };
+
+    // Free space comes from totalSize() - usedSize(), which scans the FAT
+    // on some cards, so it can be turned off.
+    void setSpaceCheck(bool on) {
+      this->space_check = on;
+    };
+    // Called with the new, empty file and its length. Return false to
+    // refuse the file. NULL = none.
+    typedef bool (*prealloc_func_t)(File &file, uint32_t length);
+    void setPreallocate(prealloc_func_t prealloc) {
+      this->prealloc = prealloc;
+    };
+
+    virtual bool begin_file(const char *name, uint32_t length);
+    virtual size_t write(const uint8_t *data, size_t len);
+    virtual bool end_file(void);
+    virtual void cancel_file(const char *name);
+    virtual bool readable(void) { return true; };
+    virtual int read(uint32_t pos, uint8_t *data, size_t len);
+
+  private:
+    File file;
+    FS *fsptr;
+    Stream *debugPort;
+    bool space_check = true;
+    prealloc_func_t prealloc = NULL;
+
+    bool space_for(const char *name, uint32_t length);
+};
+
+/*
+ * A fixed RAM buffer, for example a staging area for a parser. Each file
+ * starts at the beginning of the buffer. A file with a known length that
+ * does not fit is refused. Data past the end of the buffer is dropped and
+ * write() returns short.
+ */
+class XYramSink : public XYsink {
+  public:
+    XYramSink(uint8_t *buf, size_t size) {
+      this->buf = buf;
+      this->size = size;
+    };
+
+    // Bytes of the last file in the buffer.
+    size_t length(void) { return used; };
+    // True after the last file ended.
+    bool complete(void) { return done; };
+
+    virtual bool begin_file(const char *name, uint32_t length);
+    virtual size_t write(const uint8_t *data, size_t len);
+    virtual bool end_file(void);
+    virtual void cancel_file(const char *name);
+    virtual bool readable(void) { return true; };
+    virtual int read(uint32_t pos, uint8_t *data, size_t len);
+
+  private:
+    uint8_t *buf;
+    size_t size;
+    size_t used = 0;
+    bool done = false;
+};
+
+/*
+ * Plain functions, for example a codec or a parser fed as the data comes
+ * in. begin and end may be NULL.
+ */
+class XYcallbackSink : public XYsink {
+  public:
+    typedef bool (*begin_func_t)(const char *name, uint32_t length);
+    typedef size_t (*write_func_t)(const uint8_t *data, size_t len);
+    typedef void (*end_func_t)(void);
+
+    XYcallbackSink(write_func_t write_cb, begin_func_t begin_cb=NULL,
+        end_func_t end_cb=NULL) {
+      this->write_cb = write_cb;
+      this->begin_cb = begin_cb;
+      this->end_cb = end_cb;
+    };
+
+    virtual bool begin_file(const char *name, uint32_t length) {
+      return (begin_cb != NULL) ? begin_cb(name, length) : true;
+    };
+    virtual size_t write(const uint8_t *data, size_t len) {
+      return write_cb(data, len);
+    };
+    virtual bool end_file(void) {
+      if (end_cb != NULL) end_cb();
+      return true;
+    };
+
+  private:
+    write_func_t write_cb;
+    begin_func_t begin_cb;
+    end_func_t end_cb;
+};
+
+#endif /* _XYSINK_H_ */
@@ -0,0 +1,83 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _XYTRACE_H_
+#define _XYTRACE_H_
+
+#include <Arduino.h>
+
+/*
+ * Compile time trace levels. Each level includes the ones before it.
+ *
+ *    XYMODEM_TRACE_OFF     nothing
+ *    XYMODEM_TRACE_ERROR   timeouts, bad blocks, file errors
+ *    XYMODEM_TRACE_STATE   session and file start/end
+ *    XYMODEM_TRACE_BLOCK   one line per block
+ *    XYMODEM_TRACE_BYTE    one line per header byte (very slow)
+ *
+ * Trace call sites above XYMODEM_TRACE_LEVEL compile to nothing so their
+ * format strings do not take up flash. Enabled call sites print one
+ * formatted line to the debug port, if one was given to the constructor.
+ */
+
+#define XYMODEM_TRACE_OFF   0
+#define XYMODEM_TRACE_ERROR 1
+#define XYMODEM_TRACE_STATE 2
+#define XYMODEM_TRACE_BLOCK 3
+#define XYMODEM_TRACE_BYTE  4
+
+#ifndef XYMODEM_TRACE_LEVEL
+#define XYMODEM_TRACE_LEVEL XYMODEM_TRACE_ERROR
+#endif
+
+void xytrace_printf(Stream *debugPort, const char *fmt, ...)
+  __attribute__((format(printf, 2, 3)));
+
+#define xytrace_off(...) do {} while (0)
+
+#if XYMODEM_TRACE_LEVEL >= XYMODEM_TRACE_ERROR
+#define xytrace_error(...) xytrace_printf(debugPort, __VA_ARGS__)
+#else
+#define xytrace_error(...) xytrace_off()
+#endif
+
+#if XYMODEM_TRACE_LEVEL >= XYMODEM_TRACE_STATE
+#define xytrace_state(...) xytrace_printf(debugPort, __VA_ARGS__)
+#else
+#define xytrace_state(...) xytrace_off()
+#endif
+
+#if XYMODEM_TRACE_LEVEL >= XYMODEM_TRACE_BLOCK
+#define xytrace_block(...) xytrace_printf(debugPort, __VA_ARGS__)
+#else
+#define xytrace_block(...) xytrace_off()
+#endif
+
+#if XYMODEM_TRACE_LEVEL >= XYMODEM_TRACE_BYTE
+#define xytrace_byte(...) xytrace_printf(debugPort, __VA_ARGS__)
+#else
+#define xytrace_byte(...) xytrace_off()
+#endif
+
+#endif /* _XYTRACE_H_ */
@@ -0,0 +1,581 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Arduino.h>
+#include <zmodem.h>
+#include <xycrc.h>
+#include <xytrace.h>
+#include <xypath.h>
+
+#define ZPAD '*'
+#define ZDLE 0x18
+#define ZDLEE (ZDLE^0x40)
+#define ZBIN 'A'
+#define ZHEX 'B'
+#define ZBIN32 'C'
+
+// Frame types
+#define ZRQINIT 0
+#define ZRINIT 1
+#define ZSINIT 2
+#define ZACK 3
+#define ZFILE 4
+#define ZSKIP 5
+#define ZNAK 6
+#define ZABORT 7
+#define ZFIN 8
+#define ZRPOS 9
+#define ZDATA 10
+#define ZEOF 11
+#define ZFERR 12
+#define ZCAN 16
+
+// Data subpacket ends
+#define ZCRCE 'h'
+#define ZCRCG 'i'
+#define ZCRCQ 'j'
+#define ZCRCW 'k'
+#define ZRUB0 'l'
+#define ZRUB1 'm'
+
+// ZFILE conversion option in ZF0
+#define ZCRESUM 3             // resume an interrupted transfer (sz -r)
+
+// ZRINIT capabilities in ZF0
+#define CANFDX 0x01
+#define CANOVIO 0x02
+#define CANFC32 0x20
+
+#define XON 0x11
+#define XOFF 0x13
+
+int Zmodem::start_rz(Stream &port, FS &filesys)
+{
+  return start_rz(port, filesys, NULL);
+}
+
+/*
+ * Start ZMODEM receive. Files go in rx_directory, or the root directory if
+ * it is NULL or empty.
+ */
+int Zmodem::start_rz(Stream &port, FS &filesys, const char *rx_directory)
+{
+  if (rx_buf == NULL) {
+    // room for the frame end and CRC-32 after the largest subpacket
+    rx_buf = (uint8_t*)malloc(SUBPACKET_MAX + 5);
+    if (rx_buf == NULL) {
+      xytrace_error("Zmodem malloc failed");
+      return 1;
+    }
+  }
+  this->port = &port;
+  this->fsptr = &filesys;
+  if (rx_directory != NULL && *rx_directory != '\0') {
+    strncpy(rx_dirname, rx_directory, sizeof(rx_dirname)-1);
+    rx_dirname[sizeof(rx_dirname)-1] = '\0';
+  } else {
+    strcpy(rx_dirname, "");
+  }
+  rzmodem.close();
+  retries = 0;
+  cancount = 0;
+  file_pos = 0;
+  send_zrinit();
+  seek_header();
+  return 0;
+}
+
+int Zmodem::loop(void)
+{
+  if (rzmodem_state == IDLE) return 0;
+
+  if ((int32_t)(clock_ms() - next_millis) > 0) {
+    if (rzmodem_state == FINISH) {
+      // No "OO" from the sender. The session is over anyway.
+      rzmodem_state = IDLE;
+      return 0;
+    }
+    if (++retries > MAX_RETRIES) {
+      xytrace_error("Zmodem too many timeouts");
+      cancel();
+      return 0;
+    }
+    xytrace_error("Zmodem timeout");
+    if (rzmodem) {
+      send_pos_header(ZRPOS, file_pos);
+    }
+    else {
+      send_zrinit();
+    }
+    seek_header();
+    return rzmodem_state;
+  }
+
+  uint8_t chunk[64];
+  int bytesAvail;
+  while ((rzmodem_state != IDLE) && ((bytesAvail = port->available()) > 0)) {
+    int bytesIn = port->readBytes((char *)chunk, min(bytesAvail, (int)sizeof(chunk)));
+    for (int i = 0; (i < bytesIn) && (rzmodem_state != IDLE); i++) {
+      rx_byte(chunk[i]);
+    }
+    next_millis = clock_ms() + ((rzmodem_state == FINISH) ? TIMEOUT_FINISH : TIMEOUT);
+  }
+  return rzmodem_state;
+}
+
+void Zmodem::seek_header(void)
+{
+  rzmodem_state = HDRSEEK;
+  seek_state = 0;
+  zdle_escape = false;
+  next_millis = clock_ms() + TIMEOUT;
+}
+
+/*
+ * Decode one byte of a ZDLE encoded binary header or data subpacket.
+ * Returns 0..255 for a data byte, 0x100 | end for a subpacket end, -1 if
+ * there is nothing yet and -2 for a bad escape.
+ */
+int Zmodem::zdle_decode(uint8_t c)
+{
+  if (zdle_escape) {
+    zdle_escape = false;
+    switch (c) {
+      case ZCRCE: case ZCRCG: case ZCRCQ: case ZCRCW:
+        return 0x100 | c;
+      case ZRUB0:
+        return 0x7F;
+      case ZRUB1:
+        return 0xFF;
+      default:
+        if ((c & 0x60) == 0x40) return c ^ 0x40;
+        return -2;
+    }
+  }
+  if (c == ZDLE) {
+    zdle_escape = true;
+    return -1;
+  }
+  // Flow control characters are never data. They are always escaped.
+  if ((c & 0x7F) == XON || (c & 0x7F) == XOFF) return -1;
+  return c;
+}
+
+void Zmodem::rx_byte(uint8_t c)
+{
+  int d;
+
+  // Five CANs in a row cancel the session in any state.
+  if (c == ZDLE) {
+    if (++cancount >= 5) {
+      xytrace_error("Zmodem cancelled by sender");
+      rzmodem.close();
+      rzmodem_state = IDLE;
+      return;
+    }
+  }
+  else {
+    cancount = 0;
+  }
+
+  switch (rzmodem_state) {
+    case IDLE:
+    case FINISH:
+      // Sender says "OO" (over and out) after ZFIN.
+      if (c == 'O') {
+        if (++seek_state >= 2) rzmodem_state = IDLE;
+      }
+      break;
+    case HDRSEEK:
+      if (c == ZPAD) {
+        seek_state = 1;
+      }
+      else if (seek_state == 1 && c == ZDLE) {
+        seek_state = 2;
+      }
+      else if (seek_state == 2 && (c == ZHEX || c == ZBIN || c == ZBIN32)) {
+        hdr_len = 0;
+        zdle_escape = false;
+        crc32 = (c == ZBIN32);
+        rzmodem_state = (c == ZHEX) ? HDRHEX : HDRBIN;
+      }
+      else {
+        seek_state = 0;
+      }
+      break;
+    case HDRHEX:
+      if (isxdigit(c)) {
+        hdr_buf[hdr_len++] = c;
+        if (hdr_len == sizeof(hdr_buf)) {
+          uint8_t h[7];
+          for (int i = 0; i < 7; i++) {
+            char hex[3] = { (char)hdr_buf[i*2], (char)hdr_buf[i*2+1], '\0' };
+            h[i] = strtoul(hex, NULL, 16);
+          }
+          if (XYcrc16::update(0, h, 7) == 0) {
+            crc32 = false;
+            hdr_type = h[0];
+            memcpy(hdr, &h[1], 4);
+            header_received();
+          }
+          else {
+            xytrace_error("Zmodem hex header CRC bad");
+            seek_header();
+          }
+        }
+      }
+      else {
+        seek_header();
+      }
+      break;
+    case HDRBIN:
+      d = zdle_decode(c);
+      if (d == -1) break;
+      if (d < 0 || d > 0xFF) {
+        seek_header();
+        break;
+      }
+      hdr_buf[hdr_len++] = d;
+      if (hdr_len == 5 + ((crc32) ? 4 : 2)) {
+        bool good;
+        if (crc32) {
+          uint32_t crc = XYcrc32::update(0, hdr_buf, 5);
+          good = (crc == ((uint32_t)hdr_buf[5] | ((uint32_t)hdr_buf[6] << 8) |
+                ((uint32_t)hdr_buf[7] << 16) | ((uint32_t)hdr_buf[8] << 24)));
+        }
+        else {
+          good = (XYcrc16::update(0, hdr_buf, 7) == 0);
+        }
+        if (good) {
+          hdr_type = hdr_buf[0];
+          memcpy(hdr, &hdr_buf[1], 4);
+          header_received();
+        }
+        else {
+          xytrace_error("Zmodem binary header CRC bad");
+          if (rzmodem) send_pos_header(ZRPOS, file_pos);
+          seek_header();
+        }
+      }
+      break;
+    case DATA:
+      d = zdle_decode(c);
+      if (d == -1) break;
+      if (d == -2) {
+        xytrace_error("Zmodem bad escape");
+        if (subpacket_for == SUB_ZDATA) send_pos_header(ZRPOS, file_pos);
+        seek_header();
+      }
+      else if (d > 0xFF) {
+        frameend = d & 0xFF;
+        crc_len = 0;
+        rzmodem_state = DATACRC;
+      }
+      else if (rx_len < SUBPACKET_MAX) {
+        rx_buf[rx_len++] = d;
+      }
+      else {
+        xytrace_error("Zmodem subpacket too long");
+        if (subpacket_for == SUB_ZDATA) send_pos_header(ZRPOS, file_pos);
+        seek_header();
+      }
+      break;
+    case DATACRC:
+      d = zdle_decode(c);
+      if (d == -1) break;
+      if (d < 0 || d > 0xFF) {
+        if (subpacket_for == SUB_ZDATA) send_pos_header(ZRPOS, file_pos);
+        seek_header();
+        break;
+      }
+      crc_buf[crc_len++] = d;
+      if (crc_len == ((crc32) ? 4 : 2)) {
+        subpacket_received();
+      }
+      break;
+  }
+}
+
+void Zmodem::header_received(void)
+{
+  uint32_t pos = (uint32_t)hdr[0] | ((uint32_t)hdr[1] << 8) |
+    ((uint32_t)hdr[2] << 16) | ((uint32_t)hdr[3] << 24);
+
+  xytrace_block("Zmodem header %u pos=%lu", hdr_type, (unsigned long)pos);
+  retries = 0;
+  seek_header();
+  switch (hdr_type) {
+    case ZRQINIT:
+      send_zrinit();
+      break;
+    case ZSINIT:
+      subpacket_for = SUB_ZSINIT;
+      rx_len = 0;
+      rzmodem_state = DATA;
+      break;
+    case ZFILE:
+      // ZF0 is the last header byte.
+      resume = (hdr[3] == ZCRESUM);
+      subpacket_for = SUB_ZFILE;
+      rx_len = 0;
+      rzmodem_state = DATA;
+      break;
+    case ZDATA:
+      if (!rzmodem) {
+        send_zrinit();
+      }
+      else if (pos != file_pos) {
+        // Data from the wrong place. Ask for it again from where we are.
+        send_pos_header(ZRPOS, file_pos);
+      }
+      else {
+        subpacket_for = SUB_ZDATA;
+        rx_len = 0;
+        rzmodem_state = DATA;
+      }
+      break;
+    case ZEOF:
+      // An EOF at the wrong place is ignored. The timeout sends ZRPOS.
+      if (rzmodem && pos == file_pos) {
+        xytrace_state("Zmodem file done <%s> length=%lu", rx_filename,
+            (unsigned long)file_pos);
+        rzmodem.close();
+        send_zrinit();
+      }
+      break;
+    case ZFIN:
+      send_hex_header(ZFIN, (const uint8_t *)"\0\0\0\0");
+      rzmodem_state = FINISH;
+      seek_state = 0;
+      next_millis = clock_ms() + TIMEOUT_FINISH;
+      break;
+    case ZABORT:
+    case ZFERR:
+    case ZCAN:
+      xytrace_error("Zmodem sender abort %u", hdr_type);
+      rzmodem.close();
+      rzmodem_state = IDLE;
+      break;
+    case ZNAK:
+      if (rzmodem) {
+        send_pos_header(ZRPOS, file_pos);
+      }
+      else {
+        send_zrinit();
+      }
+      break;
+    default:
+      // ZCOMMAND, ZFREECNT etc. are not supported.
+      break;
+  }
+}
+
+void Zmodem::subpacket_received(void)
+{
+  bool good;
+
+  rx_buf[rx_len] = frameend;
+  if (crc32) {
+    uint32_t crc = XYcrc32::update(0, rx_buf, rx_len + 1);
+    good = (crc == ((uint32_t)crc_buf[0] | ((uint32_t)crc_buf[1] << 8) |
+          ((uint32_t)crc_buf[2] << 16) | ((uint32_t)crc_buf[3] << 24)));
+  }
+  else {
+    uint16_t crc = XYcrc16::update(0, rx_buf, rx_len + 1);
+    good = (crc == (((uint16_t)crc_buf[0] << 8) | crc_buf[1]));
+  }
+
+  if (!good) {
+    xytrace_error("Zmodem data CRC bad pos=%lu", (unsigned long)file_pos);
+    if (subpacket_for == SUB_ZDATA) {
+      send_pos_header(ZRPOS, file_pos);
+    }
+    else {
+      send_hex_header(ZNAK, (const uint8_t *)"\0\0\0\0");
+    }
+    seek_header();
+    return;
+  }
+
+  switch (subpacket_for) {
+    case SUB_ZSINIT:
+      // The attention string is not used.
+      send_pos_header(ZACK, 1);
+      seek_header();
+      return;
+    case SUB_ZFILE:
+      seek_header();
+      file_info();
+      return;
+    case SUB_ZDATA:
+      if (rzmodem.write(rx_buf, rx_len) != rx_len) {
+        // Full file system, flash error.
+        xytrace_error("Zmodem write failed <%s> pos=%lu", rx_filename,
+            (unsigned long)file_pos);
+        cancel();
+        return;
+      }
+      file_pos += rx_len;
+      xytrace_block("Zmodem data %u pos=%lu", rx_len, (unsigned long)file_pos);
+      break;
+    default:
+      seek_header();
+      return;
+  }
+
+  // More ZDATA subpackets follow ZCRCG and ZCRCQ. A header follows ZCRCE
+  // and ZCRCW. The sender waits for an ACK after ZCRCQ and ZCRCW.
+  rx_len = 0;
+  switch (frameend) {
+    case ZCRCG:
+      rzmodem_state = DATA;
+      break;
+    case ZCRCQ:
+      send_pos_header(ZACK, file_pos);
+      rzmodem_state = DATA;
+      break;
+    case ZCRCW:
+      send_pos_header(ZACK, file_pos);
+      seek_header();
+      break;
+    default:
+      seek_header();
+      break;
+  }
+}
+
+/*
+ * ZFILE data subpacket: file name, NUL, then length in decimal and other
+ * fields separated by spaces. A file of the same name and length is already
+ * here, so skip it. Resume from the end of a shorter one only if the sender
+ * asked for crash recovery, otherwise replace it.
+ */
+void Zmodem::file_info(void)
+{
+  // A ZFILE after an aborted ZDATA finds the last file still open.
+  rzmodem.close();
+
+  rx_buf[rx_len] = '\0';
+  size_t namelen = strlen((const char *)rx_buf);
+  bool has_length = (namelen + 1 < rx_len);
+  file_length = 0;
+  if (has_length) {
+    file_length = strtoul((const char *)&rx_buf[namelen + 1], NULL, 10);
+  }
+  if (namelen == 0 ||
+      xy_full_pathname(rx_dirname, (char *)rx_buf, rx_filename, sizeof(rx_filename)) != 0) {
+    send_hex_header(ZSKIP, (const uint8_t *)"\0\0\0\0");
+    return;
+  }
+
+  bool found = false;
+  uint32_t existing = 0;
+  if (fsptr->exists(rx_filename)) {
+    File f = fsptr->open(rx_filename, FILE_READ);
+    if (f) {
+      found = true;
+      existing = f.size();
+      f.close();
+    }
+  }
+  if (found && has_length && (existing == file_length)) {
+    xytrace_state("Zmodem skip <%s> length=%lu", rx_filename,
+        (unsigned long)existing);
+    send_hex_header(ZSKIP, (const uint8_t *)"\0\0\0\0");
+    return;
+  }
+  if (!resume || (existing > file_length)) {
+    // FILE_WRITE appends, so start from an empty file.
+    fsptr->remove(rx_filename);
+  }
+  rzmodem = fsptr->open(rx_filename, FILE_WRITE);
+  if (!rzmodem) {
+    xytrace_error("Zmodem open failed <%s>", rx_filename);
+    send_hex_header(ZSKIP, (const uint8_t *)"\0\0\0\0");
+    return;
+  }
+  // Resume from whatever is already there. Use the open file's length in
+  // case the file system truncated on open.
+  file_pos = rzmodem.size();
+  rzmodem.seek(file_pos);
+  xytrace_state("Zmodem receiving <%s> length=%lu from=%lu", rx_filename,
+      (unsigned long)file_length, (unsigned long)file_pos);
+  send_pos_header(ZRPOS, file_pos);
+}
+
+void Zmodem::send_zrinit(void)
+{
+  // Buffer size 0 = the sender may stream without waiting for ACKs.
+  uint8_t h[4] = { 0, 0, 0, CANFDX | CANOVIO | CANFC32 };
+  send_hex_header(ZRINIT, h);
+}
+
+void Zmodem::send_pos_header(uint8_t type, uint32_t pos)
+{
+  uint8_t h[4] = {
+    (uint8_t)pos, (uint8_t)(pos >> 8), (uint8_t)(pos >> 16), (uint8_t)(pos >> 24)
+  };
+  send_hex_header(type, h);
+}
+
+void Zmodem::send_hex_header(uint8_t type, const uint8_t *h)
+{
+  static const char hexdigit[] = "0123456789abcdef";
+  uint8_t raw[7];
+  char out[4 + 14 + 3];
+  int len = 0;
+
+  raw[0] = type;
+  memcpy(&raw[1], h, 4);
+  uint16_t crc = XYcrc16::update(0, raw, 5);
+  raw[5] = crc >> 8;
+  raw[6] = crc & 0xFF;
+  out[len++] = ZPAD;
+  out[len++] = ZPAD;
+  out[len++] = ZDLE;
+  out[len++] = ZHEX;
+  for (int i = 0; i < 7; i++) {
+    out[len++] = hexdigit[raw[i] >> 4];
+    out[len++] = hexdigit[raw[i] & 0x0F];
+  }
+  out[len++] = '\r';
+  out[len++] = '\n' | 0x80;
+  if (type != ZFIN && type != ZACK) {
+    out[len++] = XON;
+  }
+  port->write((const uint8_t *)out, len);
+  port->flush();
+}
+
+void Zmodem::cancel(void)
+{
+  static const uint8_t canit[] = {
+    ZDLE, ZDLE, ZDLE, ZDLE, ZDLE, ZDLE, ZDLE, ZDLE,
+    8, 8, 8, 8, 8, 8, 8, 8
+  };
+  port->write(canit, sizeof(canit));
+  port->flush();
+  rzmodem.close();
+  rzmodem_state = IDLE;
+}
@@ -0,0 +1,124 @@
+/*
+MIT License
+
+Copyright (c) 2018 gdsports625@gmail.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _ZMODEM_H_
+#define _ZMODEM_H_
+
+#include <FS.h>
+
+/*
+ * ZMODEM receive.
+ *
+ * * Streaming data subpackets, CRC-16 and CRC-32.
+ * * A file with the same name and length is already here and is skipped
+ *   (ZSKIP).
+ * * Crash recovery. If the sender asks for it (ZF0 = ZCRESUM, sz -r) and a
+ *   shorter file with the same name exists, the transfer resumes from its
+ *   end (ZRPOS) instead of starting over. Otherwise the file is replaced.
+ * * A short write to the file cancels the transfer.
+ *
+ * Same non-blocking model as XYmodem. Call start_rz() then call loop() until
+ * it returns 0.
+ *
+ * Meant to work with lrzsz sz. test_zmodem only drives a scripted sender,
+ * bench.sh runs sz against it through test/xyrecv -z.
+ */
+class Zmodem {
+  public:
+    Zmodem() {
+      this->debugPort = NULL;
+    };
+
+    Zmodem(Stream *debugPort) {
+      this->debugPort = debugPort;
+    };
+
+    ~Zmodem() {
+      free(rx_buf);
+    };
+
+    // Owns rx_buf, so a copy would free it twice.
+    Zmodem(const Zmodem &) = delete;
+    Zmodem &operator=(const Zmodem &) = delete;
+
+    int start_rz(Stream &port, FS &filesys);
+    int start_rz(Stream &port, FS &filesys, const char *rx_directory);
+    int loop(void);
+
+    typedef uint32_t (*clock_func_t)(void);
+    void setClock(clock_func_t clock_ms) {
+      this->clock_ms = (clock_ms != NULL) ? clock_ms : default_clock;
+    };
+
+  private:
+    const uint32_t TIMEOUT=10000;
+    const uint32_t TIMEOUT_FINISH=1000;
+    const uint8_t MAX_RETRIES=10;
+    static const uint16_t SUBPACKET_MAX=1024;
+    File rzmodem;
+    enum rzmodem_t {
+      IDLE, HDRSEEK, HDRHEX, HDRBIN, DATA, DATACRC, FINISH
+    };
+    rzmodem_t rzmodem_state = IDLE;
+    // What the next data subpacket belongs to.
+    enum { SUB_NONE, SUB_ZFILE, SUB_ZSINIT, SUB_ZDATA } subpacket_for = SUB_NONE;
+    char rx_filename[128+1];
+    char rx_dirname[128+1];
+    uint8_t *rx_buf = NULL;
+    uint16_t rx_len;
+    uint8_t hdr_type;
+    uint8_t hdr[4];
+    uint8_t hdr_buf[14];      // hex digits or decoded binary header bytes
+    uint8_t hdr_len;
+    uint8_t seek_state;       // ZPAD/ZDLE/format matching in HDRSEEK
+    bool crc32;               // CRC-32 for the current header and its data
+    bool zdle_escape;
+    uint8_t cancount;
+    uint8_t frameend;
+    uint8_t crc_buf[4];
+    uint8_t crc_len;
+    uint32_t file_pos;
+    uint32_t file_length;
+    bool resume;              // the sender asked for crash recovery
+    uint32_t next_millis;
+    uint8_t retries;
+    Stream *port;
+    Stream *debugPort;
+    FS *fsptr;
+    clock_func_t clock_ms = default_clock;
+
+    void rx_byte(uint8_t c);
+    int zdle_decode(uint8_t c);
+    void header_received(void);
+    void subpacket_received(void);
+    void file_info(void);
+    void send_hex_header(uint8_t type, const uint8_t *h);
+    void send_pos_header(uint8_t type, uint32_t pos);
+    void send_zrinit(void);
+    void cancel(void);
+    void seek_header(void);
+    static uint32_t default_clock(void) { return millis(); }
+};
+
+#endif /* _ZMODEM_H_ */